@@ -10,14 +10,74 @@
 
 #ifdef __KERNEL__
 #include <linux/string.h>
+#include <linux/compiler.h>
+#include <asm/barrier.h>
 #else
 #include <string.h>
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
 #endif
 
 #include "aesd-circular-buffer.h"
 
+/*
+ * Lookups may run without the lock of the writer, which then validates their result (for example
+ * with a seqcount) and keeps replaced slot arrays alive until they are done (for example with
+ * RCU). They read every field of the buffer once, and take mask before entry: slot arrays only
+ * ever grow after being published, and shrink in place first (aesd_circular_buffer_compact()),
+ * so any mask a lookup sees is in bounds of the entry array it sees next.
+ */
+
+/**
+ * Looks up the entry holding byte @param pos of @param buffer, counted from the first byte of the
+ * oldest entry, or from the first byte ever added if @param stream is set
+ */
+static struct aesd_buffer_entry *aesd_circular_buffer_find(struct aesd_circular_buffer *buffer,
+            size_t pos, bool stream, size_t *entry_offset_byte_rtn)
+{
+    unsigned int mask = smp_load_acquire(&buffer->mask);
+    struct aesd_buffer_entry *slots = smp_load_acquire(&buffer->entry);
+    unsigned int out = READ_ONCE(buffer->out_offs);
+    unsigned int count = READ_ONCE(buffer->count);
+    size_t base;
+    size_t char_offset;
+    unsigned int low = 0;
+    unsigned int high;
+    unsigned int mid;
+    struct aesd_buffer_entry *entry;
+
+    if (count == 0)
+        return NULL;
+
+    /* Stream positions before base belong to evicted entries, and wrap to large offsets */
+    base = READ_ONCE(slots[out & mask].start);
+    char_offset = stream ? pos - base : pos;
+    if (char_offset >= READ_ONCE(buffer->total_size))
+        return NULL;
+
+    /*
+     * Binary search for the last entry starting at or before char_offset. Entry starts only grow
+     * from out_offs on, so they form a sorted prefix sum of the entry sizes.
+     */
+    high = count - 1;
+    while (low < high) {
+        mid = low + (high - low + 1) / 2;
+        if (READ_ONCE(slots[(out + mid) & mask].start) - base <= char_offset)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    /* Calculate the byte offset into the entry where the offset falls*/
+    entry = &slots[(out + low) & mask];
+    *entry_offset_byte_rtn = char_offset - (READ_ONCE(entry->start) - base);
+    return entry;
+}
+
 /**
- * @param buffer the buffer to search for corresponding offset.  Any necessary locking must be performed by caller.
+ * @param buffer the buffer to search for corresponding offset.  Any necessary locking must be performed by caller,
+ *      or the result validated as described above.
  * @param char_offset the position to search for in the buffer list, describing the zero referenced
  *      character index if all buffer strings were concatenated end to end
  * @param entry_offset_byte_rtn is a pointer specifying a location to store the byte of the returned aesd_buffer_entry
@@ -29,22 +89,38 @@
 struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct aesd_circular_buffer *buffer,
             size_t char_offset, size_t *entry_offset_byte_rtn )
 {
-    size_t bytes_so_far = 0;
-    int i;
-    int index;
-    int count = (buffer->full) ? AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED : buffer->in_offs;
-
-    /* Iterate over the valid entries starting at out_offs.*/
-    for(i = 0; i < count; i++){
-        index = (buffer->out_offs + i) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-        if(char_offset < (bytes_so_far + buffer->entry[index].size)) {
-            /* Calculate the byte offset into the entry where the offset falls*/
-            *entry_offset_byte_rtn = char_offset - bytes_so_far;
-            return &buffer->entry[index];
-        }
-        bytes_so_far += buffer->entry[index].size;
-    }
-    return NULL;
+    return aesd_circular_buffer_find(buffer, char_offset, false, entry_offset_byte_rtn);
+}
+
+/**
+ * Like aesd_circular_buffer_find_entry_offset_for_fpos(), but @param stream_pos counts from the first byte ever
+ * added to the buffer, as the start member of entries does. A stream position keeps naming the same byte while
+ * older entries are evicted, until its own entry is.
+ * @return the entry holding stream_pos, or NULL if it was evicted or has not been written yet
+ */
+struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_stream_pos(struct aesd_circular_buffer *buffer,
+            size_t stream_pos, size_t *entry_offset_byte_rtn)
+{
+    return aesd_circular_buffer_find(buffer, stream_pos, true, entry_offset_byte_rtn);
+}
+
+/**
+ * @param buffer the buffer holding the entry.  Any necessary locking must be performed by caller,
+ *      or the result validated as described above.
+ * @param entry_number the zero referenced number of the entry, counted from the oldest one
+ * @return the char_offset of the first byte of the entry if all buffer strings were concatenated end to end,
+ * or the total size of the buffer if entry_number is not stored
+ */
+size_t aesd_circular_buffer_fpos_of_entry(const struct aesd_circular_buffer *buffer,
+            unsigned int entry_number)
+{
+    unsigned int mask = smp_load_acquire(&buffer->mask);
+    const struct aesd_buffer_entry *slots = smp_load_acquire(&buffer->entry);
+    unsigned int out = READ_ONCE(buffer->out_offs);
+
+    if (entry_number >= READ_ONCE(buffer->count))
+        return READ_ONCE(buffer->total_size);
+    return READ_ONCE(slots[(out + entry_number) & mask].start) - READ_ONCE(slots[out & mask].start);
 }
 
 /**
@@ -53,41 +129,149 @@ struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct
 * new start location.
 * Any necessary locking must be handled by the caller
 * Any memory referenced in @param add_entry must be allocated by and/or must have a lifetime managed by the caller.
+* @return the buffptr of the overwritten entry for the caller to free, or NULL if none was or
+* buffer->evict received it
 */
 const char *aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry)
 {
      const char *overwritten = NULL;
 
+     /* Drop the oldest entry and advance out_offs to the new start location if the buffer was full */
      if (buffer->full){
-        overwritten = buffer->entry[buffer->out_offs].buffptr;
+        overwritten = aesd_circular_buffer_remove_oldest(buffer);
+        if (buffer->evict != NULL) {
+            buffer->evict(overwritten, buffer->evict_ctx);
+            overwritten = NULL;
+        }
      }
 
      /* Store the new entry at the current write position */
      buffer->entry[buffer->in_offs].buffptr = add_entry->buffptr;
      buffer->entry[buffer->in_offs].size = add_entry->size;
+     buffer->entry[buffer->in_offs].start = buffer->bytes_added;
+     buffer->bytes_added += add_entry->size;
+     buffer->total_size += add_entry->size;
 
      /* Advance the in_offs pointer */
-     buffer->in_offs = (buffer->in_offs + 1) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
- 
-     /* Advance out_offs to reflect the new starting point if the buffer was full */
-     if(buffer->full) {
-         buffer->out_offs = (buffer->out_offs + 1) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-     }
- 
+     buffer->in_offs = (buffer->in_offs + 1) & buffer->mask;
+     buffer->count++;
+
      /* Check if the buffer is now full */
-     if(buffer->in_offs == buffer->out_offs) {
-         buffer->full = true;
-     } else {
-         buffer->full = false;
-     }
+     buffer->full = (buffer->count == buffer->depth);
 
      return overwritten;
 }
 
 /**
-* Initializes the circular buffer described by @param buffer to an empty struct
+* Removes the oldest entry of @param buffer, advancing buffer->out_offs.
+* Any necessary locking must be handled by the caller
+* @return the buffptr of the removed entry, for the caller to free, or NULL if the buffer was empty
+*/
+const char *aesd_circular_buffer_remove_oldest(struct aesd_circular_buffer *buffer)
+{
+    struct aesd_buffer_entry *oldest;
+    const char *buffptr;
+
+    if (buffer->count == 0)
+        return NULL;
+
+    oldest = &buffer->entry[buffer->out_offs];
+    buffptr = oldest->buffptr;
+    buffer->total_size -= oldest->size;
+    oldest->buffptr = NULL;
+    oldest->size = 0;
+
+    buffer->out_offs = (buffer->out_offs + 1) & buffer->mask;
+    buffer->count--;
+    buffer->full = false;
+    return buffptr;
+}
+
+/**
+* Reverses the order of the slots of @param entry from @param first up to, excluding, @param last
+*/
+static void aesd_circular_buffer_reverse(struct aesd_buffer_entry *entry, unsigned int first, unsigned int last)
+{
+    struct aesd_buffer_entry tmp;
+
+    while (first + 1 < last) {
+        last--;
+        tmp = entry[first];
+        entry[first] = entry[last];
+        entry[last] = tmp;
+        first++;
+    }
+}
+
+/**
+* Moves the entries of @param buffer to the start of its slot array, restricts the buffer to the
+* first @param nslots slots and changes the number of entries kept to @param depth, so the array
+* can later be replaced by a smaller one and entries can be added meanwhile.
+* nslots must be a power of two, no more than the current number of slots and at least depth, and
+* the buffer must not hold more than depth entries, see aesd_circular_buffer_remove_oldest().
+* Any necessary locking must be handled by the caller. Lookups running concurrently may still
+* use the previous number of slots until they are done.
+*/
+void aesd_circular_buffer_compact(struct aesd_circular_buffer *buffer, unsigned int nslots,
+            unsigned int depth)
+{
+    unsigned int slots = buffer->mask + 1;
+
+    /* Rotate the whole array left by out_offs, which brings the oldest entry to the first slot */
+    aesd_circular_buffer_reverse(buffer->entry, 0, buffer->out_offs);
+    aesd_circular_buffer_reverse(buffer->entry, buffer->out_offs, slots);
+    aesd_circular_buffer_reverse(buffer->entry, 0, slots);
+
+    buffer->depth = depth;
+    buffer->out_offs = 0;
+    buffer->in_offs = buffer->count & (nslots - 1);
+    buffer->full = (buffer->count == depth);
+    smp_store_release(&buffer->mask, nslots - 1);
+}
+
+/**
+* Moves the entries of @param buffer to the array @param slots of @param nslots entries, and
+* changes the number of entries kept by the buffer to @param depth.
+* nslots must be a power of two of at least depth and of at least the current number of slots,
+* see aesd_circular_buffer_compact() to shrink, and the buffer must not hold more than depth
+* entries, see aesd_circular_buffer_remove_oldest().
+* Any necessary locking must be handled by the caller. The previous slot array must be kept
+* until concurrent lookups are done with it.
+* @return the previous slot array for the caller to free, or NULL if the buffer was still using
+* its inline slots
+*/
+struct aesd_buffer_entry *aesd_circular_buffer_resize(struct aesd_circular_buffer *buffer,
+            struct aesd_buffer_entry *slots, unsigned int nslots, unsigned int depth)
+{
+    struct aesd_buffer_entry *old = buffer->entry;
+    unsigned int i;
+
+    /* Copy the entries in order, the oldest one going to the first slot */
+    memset(slots, 0, nslots * sizeof(*slots));
+    for (i = 0; i < buffer->count; i++) {
+        slots[i] = old[(buffer->out_offs + i) & buffer->mask];
+    }
+
+    buffer->depth = depth;
+    buffer->out_offs = 0;
+    buffer->in_offs = buffer->count & (nslots - 1);
+    buffer->full = (buffer->count == depth);
+
+    /* Publish the larger array before the larger mask */
+    smp_store_release(&buffer->entry, slots);
+    smp_store_release(&buffer->mask, nslots - 1);
+
+    return (old == buffer->inline_entry) ? NULL : old;
+}
+
+/**
+* Initializes the circular buffer described by @param buffer to an empty struct, keeping
+* AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED entries in its inline slots
 */
 void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer)
 {
     memset(buffer,0,sizeof(struct aesd_circular_buffer));
+    buffer->entry = buffer->inline_entry;
+    buffer->mask = AESD_CIRCULAR_BUFFER_INLINE_SLOTS - 1;
+    buffer->depth = AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
 }
@@ -16,7 +16,19 @@
 #include <stdbool.h>
 #endif
 
+/**
+ * The default number of write operations kept in the buffer
+ */
 #define AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED 10
+/**
+ * The number of slots stored inside struct aesd_circular_buffer, the smallest power of two
+ * holding the default number of write operations
+ */
+#define AESD_CIRCULAR_BUFFER_INLINE_SLOTS 16
+/**
+ * The largest number of write operations the buffer can be resized to keep
+ */
+#define AESDCHAR_MAX_DEPTH 65536
 
 struct aesd_buffer_entry
 {
@@ -28,44 +40,101 @@ struct aesd_buffer_entry
      * Number of bytes stored in buffptr
      */
     size_t size;
+    /**
+     * Set by the circular buffer when the entry is added: the number of bytes added to the
+     * buffer before this entry, over its whole lifetime
+     */
+    size_t start;
 };
 
+/**
+ * Receives the buffptr of the entry overwritten by aesd_circular_buffer_add_entry(), along with
+ * the evict_ctx of the buffer, for the caller to free
+ */
+typedef void (*aesd_circular_buffer_evict_fn)(const char *buffptr, void *ctx);
+
 struct aesd_circular_buffer
 {
     /**
-     * An array of pointers to memory allocated for the most recent write operations
+     * An array of pointers to memory allocated for the most recent write operations.
+     * The number of slots is a power of two, so positions wrap with mask instead of a modulo.
+     */
+    struct aesd_buffer_entry *entry;
+    /**
+     * The number of slots in entry minus one
+     */
+    unsigned int mask;
+    /**
+     * The number of write operations kept before the oldest one is overwritten, at most
+     * mask + 1
      */
-    struct aesd_buffer_entry  entry[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED];
+    unsigned int depth;
+    /**
+     * The number of write operations currently stored
+     */
+    unsigned int count;
     /**
      * The current location in the entry structure where the next write should
      * be stored.
      */
-    uint8_t in_offs;
+    unsigned int in_offs;
     /**
      * The first location in the entry structure to read from
      */
-    uint8_t out_offs;
+    unsigned int out_offs;
     /**
-     * set to true when the buffer entry structure is full
+     * set to true when the buffer holds depth entries
      */
     bool full;
+    /**
+     * The number of bytes stored over all entries
+     */
+    size_t total_size;
+    /**
+     * The number of bytes added over the lifetime of the buffer, the start of the next entry
+     */
+    size_t bytes_added;
+    /**
+     * Called with the entry aesd_circular_buffer_add_entry() overwrites, if set, instead of
+     * returning it
+     */
+    aesd_circular_buffer_evict_fn evict;
+    void *evict_ctx;
+    /**
+     * The slots used until the buffer is resized to an array of its own
+     */
+    struct aesd_buffer_entry inline_entry[AESD_CIRCULAR_BUFFER_INLINE_SLOTS];
 };
 
 extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct aesd_circular_buffer *buffer,
             size_t char_offset, size_t *entry_offset_byte_rtn );
 
+extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_stream_pos(struct aesd_circular_buffer *buffer,
+            size_t stream_pos, size_t *entry_offset_byte_rtn);
+
+extern size_t aesd_circular_buffer_fpos_of_entry(const struct aesd_circular_buffer *buffer,
+            unsigned int entry_number);
+
 extern const char* aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry);
 
 extern void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer);
 
+extern const char *aesd_circular_buffer_remove_oldest(struct aesd_circular_buffer *buffer);
+
+extern void aesd_circular_buffer_compact(struct aesd_circular_buffer *buffer, unsigned int nslots,
+            unsigned int depth);
+
+extern struct aesd_buffer_entry *aesd_circular_buffer_resize(struct aesd_circular_buffer *buffer,
+            struct aesd_buffer_entry *slots, unsigned int nslots, unsigned int depth);
+
 /**
  * Create a for loop to iterate over each member of the circular buffer.
  * Useful when you've allocated memory for circular buffer entries and need to free it
  * @param entryptr is a struct aesd_buffer_entry* to set with the current entry
  * @param buffer is the struct aesd_buffer * describing the buffer
- * @param index is a uint8_t stack allocated value used by this macro for an index
+ * @param index is an unsigned int stack allocated value used by this macro for an index
  * Example usage:
- * uint8_t index;
+ * unsigned int index;
  * struct aesd_circular_buffer buffer;
  * struct aesd_buffer_entry *entry;
  * AESD_CIRCULAR_BUFFER_FOREACH(entry,&buffer,index) {
@@ -74,7 +143,7 @@ extern void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer);
  */
 #define AESD_CIRCULAR_BUFFER_FOREACH(entryptr,buffer,index) \
     for(index=0, entryptr=&((buffer)->entry[index]); \
-            index<AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED; \
+            index<=(buffer)->mask; \
             index++, entryptr=&((buffer)->entry[index]))
 
 
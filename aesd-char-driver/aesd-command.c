@@ -0,0 +1,388 @@
+/**
+ * @file aesd-command.c
+ * @brief Storage for the commands written to the aesdchar device
+ *
+ * Writes are copied from user space straight into the chunk which will hold them until the
+ * command is evicted, so a command growing over many writes is never reallocated or copied
+ * again. Short commands live in objects of a dedicated slab cache, long ones in chains of
+ * page sized chunks. Long commands spliced from pages nobody else holds keep referencing those
+ * pages instead of being copied, all but their first bytes.
+ *
+ * @author Abhirath Koushik
+ * @date 2026-10-16
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/srcu.h>
+#include <linux/uio.h>
+#else
+#include "userspace/kernel-shim.h"
+#endif
+#include "aesd-command.h"
+
+/**
+ * Commands are stored in slab chunks until they grow past this many bytes, then in page chunks
+ */
+#define AESD_COMMAND_PAGE_THRESHOLD (4 * (AESD_COMMAND_SLAB_SIZE - sizeof(struct aesd_chunk)))
+
+static struct kmem_cache *aesd_command_cache;
+
+/**
+ * Creates the slab cache for short commands
+ * @return 0 on success, -ENOMEM on failure
+ */
+int aesd_command_cache_create(void)
+{
+    aesd_command_cache = kmem_cache_create("aesd_command", AESD_COMMAND_SLAB_SIZE, 0,
+                                           SLAB_HWCACHE_ALIGN, NULL);
+    return aesd_command_cache ? 0 : -ENOMEM;
+}
+
+/**
+ * Destroys the slab cache, once every command has been freed
+ */
+void aesd_command_cache_destroy(void)
+{
+    kmem_cache_destroy(aesd_command_cache);
+}
+
+/**
+ * Allocates an empty chunk to store @param want bytes, see aesd_command_chunk_want()
+ * @return the chunk, or NULL if no memory is available
+ */
+static struct aesd_chunk *aesd_chunk_alloc(size_t want)
+{
+    struct aesd_chunk *chunk;
+    int order;
+
+    if (want <= AESD_COMMAND_PAGE_THRESHOLD) {
+        chunk = kmem_cache_alloc(aesd_command_cache, GFP_KERNEL);
+        if (chunk == NULL)
+            return NULL;
+        chunk->order = AESD_CHUNK_SLAB;
+        chunk->capacity = AESD_COMMAND_SLAB_SIZE - sizeof(*chunk);
+    } else {
+        order = min(get_order(want + sizeof(*chunk)), AESD_COMMAND_MAX_ORDER);
+        /* Settle for smaller chunks rather than fail when memory is fragmented */
+        for (;;) {
+            chunk = (struct aesd_chunk *)__get_free_pages(order ? GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY
+                                                                : GFP_KERNEL, order);
+            if (chunk != NULL || order == 0)
+                break;
+            order--;
+        }
+        if (chunk == NULL)
+            return NULL;
+        chunk->order = order;
+        chunk->capacity = (PAGE_SIZE << order) - sizeof(*chunk);
+    }
+    chunk->next = NULL;
+    chunk->size = 0;
+    chunk->buf = chunk->data;
+    chunk->page = NULL;
+    return chunk;
+}
+
+static void aesd_chunk_free(struct aesd_chunk *chunk)
+{
+    if (chunk->order == AESD_CHUNK_PAGE_REF) {
+        put_page(chunk->page);
+        kmem_cache_free(aesd_command_cache, chunk);
+    } else if (chunk->order == AESD_CHUNK_SLAB)
+        kmem_cache_free(aesd_command_cache, chunk);
+    else
+        free_pages((unsigned long)chunk, chunk->order);
+}
+
+/**
+ * Frees @param chunk and every chunk chained after it
+ */
+static void aesd_chunk_free_chain(struct aesd_chunk *chunk)
+{
+    struct aesd_chunk *next;
+
+    while (chunk != NULL) {
+        next = chunk->next;
+        aesd_chunk_free(chunk);
+        chunk = next;
+    }
+}
+
+/**
+ * Adds the empty @param chunk to the end of @param cmd
+ */
+static void aesd_command_add_chunk(struct aesd_command *cmd, struct aesd_chunk *chunk)
+{
+    if (cmd->tail != NULL)
+        cmd->tail->next = chunk;
+    else
+        cmd->head = chunk;
+    cmd->tail = chunk;
+}
+
+/**
+ * Returns how many bytes the next chunk of @param cmd should hold, with @param left bytes left to
+ * store. Where the command ends is only known once its bytes are copied, so chunks grow with the
+ * command instead of with the write: every command starts in a slab chunk, and each further chunk
+ * holds about as much as the command so far. Storage thus stays within about twice the command,
+ * and at most one chunk worth of the bytes after a newline is copied and given back.
+ */
+static size_t aesd_command_chunk_want(const struct aesd_command *cmd, size_t left)
+{
+    return min(left, max_t(size_t, cmd->size, 1));
+}
+
+/**
+ * Appends written data to @param cmd, up to and including the first newline.
+ * @param from the data of the write, advanced past the bytes appended
+ * @param complete set to true when a newline was appended, completing the command
+ * @return the number of bytes appended, or -ENOMEM/-EFAULT if none could be
+ */
+ssize_t aesd_command_append(struct aesd_command *cmd, struct iov_iter *from, bool *complete)
+{
+    struct aesd_chunk *chunk;
+    size_t count = iov_iter_count(from);
+    size_t done = 0;
+    size_t copied;
+    size_t n;
+    char *dst;
+    char *newline;
+
+    *complete = false;
+    while (done < count) {
+        chunk = cmd->tail;
+        if (chunk == NULL || chunk->size == chunk->capacity) {
+            chunk = aesd_chunk_alloc(aesd_command_chunk_want(cmd, count - done));
+            if (chunk == NULL)
+                return done ? done : -ENOMEM;
+            aesd_command_add_chunk(cmd, chunk);
+        }
+
+        n = min(count - done, chunk->capacity - chunk->size);
+        dst = chunk->buf + chunk->size;
+        copied = copy_from_iter(dst, n, from);
+
+        /* Anything copied past the newline is left out of the command, and in from */
+        newline = memchr(dst, '\n', copied);
+        if (newline != NULL) {
+            iov_iter_revert(from, copied - (newline - dst + 1));
+            copied = newline - dst + 1;
+            *complete = true;
+        }
+        chunk->size += copied;
+        cmd->size += copied;
+        done += copied;
+        if (*complete)
+            break;
+        if (copied < n)
+            return done ? done : -EFAULT;
+    }
+    return done;
+}
+
+/**
+ * Appends @param len bytes at @param offset of @param page to @param cmd, up to and including
+ * the first newline. Long runs after the first bytes of the command are kept by taking a reference
+ * to the page instead of copying them, so the caller must own the page: its bytes must never change
+ * again. The page must not be in high memory.
+ * @param complete set to true when a newline was appended, completing the command
+ * @return the number of bytes appended, or -ENOMEM if none could be
+ */
+ssize_t aesd_command_append_page(struct aesd_command *cmd, struct page *page, size_t offset,
+            size_t len, bool *complete)
+{
+    struct aesd_chunk *chunk;
+    char *src = (char *)page_address(page) + offset;
+    char *newline;
+    struct kvec kvec;
+    struct iov_iter iter;
+
+    newline = memchr(src, '\n', len);
+    if (newline != NULL)
+        len = newline - src + 1;
+
+    /* The first bytes of a command are always copied, so its buffptr points at data */
+    if (cmd->head == NULL)
+        len = min(len, AESD_COMMAND_SLAB_SIZE - sizeof(*chunk));
+
+    /* A reference costs a slab object, which only pays off for runs a slab object can't hold */
+    if (cmd->head == NULL || len <= AESD_COMMAND_PAGE_THRESHOLD) {
+        kvec.iov_base = src;
+        kvec.iov_len = len;
+        iov_iter_kvec(&iter, ITER_SOURCE, &kvec, 1, len);
+        return aesd_command_append(cmd, &iter, complete);
+    }
+
+    chunk = kmem_cache_alloc(aesd_command_cache, GFP_KERNEL);
+    if (chunk == NULL)
+        return -ENOMEM;
+    get_page(page);
+    chunk->next = NULL;
+    chunk->size = len;
+    chunk->capacity = len;
+    chunk->order = AESD_CHUNK_PAGE_REF;
+    chunk->buf = src;
+    chunk->page = page;
+    aesd_command_add_chunk(cmd, chunk);
+
+    cmd->size += len;
+    *complete = newline != NULL;
+    return len;
+}
+
+/**
+ * Hands the storage of @param cmd over to the caller and resets cmd for the next command
+ * @return the buffptr of the command, to be freed with aesd_command_free()
+ */
+const char *aesd_command_finish(struct aesd_command *cmd)
+{
+    const char *buffptr = cmd->head ? cmd->head->data : NULL;
+
+    cmd->head = NULL;
+    cmd->tail = NULL;
+    cmd->size = 0;
+    return buffptr;
+}
+
+/**
+ * Appends the unfinished command @param rest to the unfinished command @param cmd, moving its
+ * storage over without copying, and resets rest
+ */
+void aesd_command_join(struct aesd_command *cmd, struct aesd_command *rest)
+{
+    if (rest->head == NULL)
+        return;
+    if (cmd->tail != NULL)
+        cmd->tail->next = rest->head;
+    else
+        cmd->head = rest->head;
+    cmd->tail = rest->tail;
+    cmd->size += rest->size;
+    aesd_command_finish(rest);
+}
+
+/**
+ * Frees the storage of the unfinished command @param cmd and resets it
+ */
+void aesd_command_discard(struct aesd_command *cmd)
+{
+    aesd_chunk_free_chain(cmd->head);
+    aesd_command_finish(cmd);
+}
+
+/**
+ * Frees the storage of a command returned by aesd_command_finish()
+ */
+void aesd_command_free(const char *buffptr)
+{
+    if (buffptr != NULL)
+        aesd_chunk_free_chain(container_of(buffptr, struct aesd_chunk, data));
+}
+
+/**
+ * Returns the number of bytes of memory held by a command returned by aesd_command_finish(). It
+ * can be many times the size of the command: a short command takes a whole slab object, and a run
+ * referenced from a spliced page keeps the whole page.
+ */
+size_t aesd_command_footprint(const char *buffptr)
+{
+    struct aesd_chunk *chunk;
+    size_t bytes = 0;
+
+    if (buffptr == NULL)
+        return 0;
+    for (chunk = container_of(buffptr, struct aesd_chunk, data); chunk != NULL; chunk = chunk->next) {
+        if (chunk->order == AESD_CHUNK_SLAB)
+            bytes += AESD_COMMAND_SLAB_SIZE;
+        else if (chunk->order == AESD_CHUNK_PAGE_REF)
+            bytes += AESD_COMMAND_SLAB_SIZE + PAGE_SIZE;
+        else
+            bytes += PAGE_SIZE << chunk->order;
+    }
+    return bytes;
+}
+
+static void aesd_command_free_rcu(struct rcu_head *rcu)
+{
+    aesd_chunk_free_chain(container_of(rcu, struct aesd_chunk, rcu));
+}
+
+/**
+ * Frees the storage of a command returned by aesd_command_finish() once the SRCU read side
+ * sections of @param srcu running now are over, since readers may still be copying it
+ */
+void aesd_command_free_deferred(const char *buffptr, struct srcu_struct *srcu)
+{
+    struct aesd_chunk *chunk;
+
+    if (buffptr != NULL) {
+        chunk = container_of(buffptr, struct aesd_chunk, data);
+        call_srcu(srcu, &chunk->rcu, aesd_command_free_rcu);
+    }
+}
+
+/**
+ * Copies bytes of a finished command to kernel memory
+ * @param buffptr the command, as returned by aesd_command_finish()
+ * @param offset the offset of the first byte to copy within the command
+ * @param dst the buffer to copy to
+ * @param count the number of bytes to copy, which must be available in the command
+ */
+void aesd_command_copy(const char *buffptr, size_t offset, char *dst, size_t count)
+{
+    struct aesd_chunk *chunk = container_of(buffptr, struct aesd_chunk, data);
+    size_t n;
+
+    while (chunk != NULL && offset >= chunk->size) {
+        offset -= chunk->size;
+        chunk = chunk->next;
+    }
+    while (chunk != NULL && count > 0) {
+        n = min(count, chunk->size - offset);
+        memcpy(dst, chunk->buf + offset, n);
+        dst += n;
+        count -= n;
+        offset = 0;
+        chunk = chunk->next;
+    }
+}
+
+/**
+ * Copies bytes of a finished command to the buffers of a read
+ * @param buffptr the command, as returned by aesd_command_finish()
+ * @param offset the offset of the first byte to copy within the command
+ * @param to the buffers to copy to, advanced past the bytes copied
+ * @param count the number of bytes to copy, which must be available in the command
+ * @return the number of bytes copied, less than count if a buffer faulted or to is full
+ */
+size_t aesd_command_copy_to_iter(const char *buffptr, size_t offset, struct iov_iter *to,
+            size_t count)
+{
+    struct aesd_chunk *chunk = container_of(buffptr, struct aesd_chunk, data);
+    size_t done = 0;
+    size_t copied;
+    size_t n;
+
+    while (chunk != NULL && offset >= chunk->size) {
+        offset -= chunk->size;
+        chunk = chunk->next;
+    }
+    while (chunk != NULL && done < count) {
+        n = min(count - done, chunk->size - offset);
+        copied = copy_to_iter(chunk->buf + offset, n, to);
+        done += copied;
+        if (copied < n)
+            break;
+        offset = 0;
+        chunk = chunk->next;
+    }
+    return done;
+}
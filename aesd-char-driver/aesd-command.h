@@ -0,0 +1,124 @@
+/*
+ * aesd-command.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Abhirath Koushik
+ *
+ *  @brief Storage for the commands written to the aesdchar device
+ */
+
+#ifndef AESD_COMMAND_H
+#define AESD_COMMAND_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/uio.h>
+#else
+#include "userspace/kernel-shim.h"
+#endif
+
+struct srcu_struct;
+struct page;
+
+#ifndef ITER_SOURCE
+/* Kernels before 6.2 name the direction of an iov_iter with WRITE (copied from) and READ (copied to) */
+#define ITER_SOURCE WRITE
+#define ITER_DEST READ
+#endif
+
+/**
+ * Size of the slab objects used for short commands, header included
+ */
+#define AESD_COMMAND_SLAB_SIZE 256
+/**
+ * Largest page order used for one chunk of a long command
+ */
+#define AESD_COMMAND_MAX_ORDER 4
+
+/**
+ * One piece of the storage of a command. Short commands fit in a single chunk allocated
+ * from a slab cache, long ones are chained over chunks of whole pages, or over references to
+ * pages handed over by a splice. The first chunk of a command always holds its bytes in data,
+ * never a page reference, and its header sits right before data, so the buffptr of a committed
+ * entry (the data of its first chunk) leads back to the chunk. buffptr only points at the bytes
+ * of that first chunk though: read a command with aesd_command_copy() or
+ * aesd_command_copy_to_iter(), never through buffptr and the size of the entry.
+ */
+struct aesd_chunk
+{
+    /**
+     * The next chunk of the command, NULL for the last one
+     */
+    struct aesd_chunk *next;
+    /**
+     * Number of bytes stored in data
+     */
+    size_t size;
+    /**
+     * Number of bytes data can hold
+     */
+    size_t capacity;
+    /**
+     * Page order of the chunk, AESD_CHUNK_SLAB for a slab object, or AESD_CHUNK_PAGE_REF for a
+     * slab object referencing bytes of page
+     */
+    int order;
+    /**
+     * The bytes of the chunk: data, or the referenced bytes of page
+     */
+    char *buf;
+    /**
+     * The page an AESD_CHUNK_PAGE_REF chunk holds a reference to
+     */
+    struct page *page;
+    /**
+     * Used by the first chunk of a command to defer freeing it
+     */
+    struct rcu_head rcu;
+    char data[];
+};
+
+#define AESD_CHUNK_SLAB (-1)
+#define AESD_CHUNK_PAGE_REF (-2)
+
+/**
+ * A command which is still being written
+ */
+struct aesd_command
+{
+    struct aesd_chunk *head;
+    struct aesd_chunk *tail;
+    /**
+     * Number of bytes stored over all chunks
+     */
+    size_t size;
+};
+
+extern int aesd_command_cache_create(void);
+
+extern void aesd_command_cache_destroy(void);
+
+extern ssize_t aesd_command_append(struct aesd_command *cmd, struct iov_iter *from, bool *complete);
+
+extern ssize_t aesd_command_append_page(struct aesd_command *cmd, struct page *page, size_t offset,
+            size_t len, bool *complete);
+
+extern const char *aesd_command_finish(struct aesd_command *cmd);
+
+extern void aesd_command_join(struct aesd_command *cmd, struct aesd_command *rest);
+
+extern void aesd_command_discard(struct aesd_command *cmd);
+
+extern void aesd_command_free(const char *buffptr);
+
+extern size_t aesd_command_footprint(const char *buffptr);
+
+extern void aesd_command_free_deferred(const char *buffptr, struct srcu_struct *srcu);
+
+extern void aesd_command_copy(const char *buffptr, size_t offset, char *dst, size_t count);
+
+extern size_t aesd_command_copy_to_iter(const char *buffptr, size_t offset, struct iov_iter *to,
+            size_t count);
+
+#endif /* AESD_COMMAND_H */
@@ -0,0 +1,800 @@
+/**
+ * @file aesd-core.c
+ * @brief Read, write, seek and ioctl logic of the AESD char driver
+ *
+ * Everything the file operations of an aesdchar device do besides splice and mmap, which need
+ * the page cache and the VM. main.c registers the devices and hands their operations here. Built
+ * without __KERNEL__, this file runs on the userspace stand-ins of userspace/kernel-shim.h, so
+ * the driver logic can be benchmarked and fuzzed without loading the module.
+ *
+ * @author Abhirath Koushik
+ * @date 2026-10-16
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
+#include <linux/srcu.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/uio.h>
+#include <linux/uaccess.h>
+#else
+#include "userspace/kernel-shim.h"
+#endif
+#include "aesdchar.h"
+#include "aesd_ioctl.h"
+#include "aesd-command.h"
+
+/*
+ * Readers never take dev->lock. Evicted commands and replaced slot arrays are only freed once the
+ * aesd_srcu read side sections running at the time are over, and every lookup is validated
+ * against dev->seq so it never mixes two states of the buffer. SRCU rather than RCU because
+ * readers sleep in copy_to_user().
+ */
+DEFINE_SRCU(aesd_srcu);
+
+int aesd_open(struct inode *inode, struct file *filp)
+{
+    PDEBUG("open");
+    struct aesd_file *file;
+    file = kmalloc(sizeof(*file), GFP_KERNEL);
+    if (file == NULL)
+        return -ENOMEM;
+    file->dev = container_of(inode->i_cdev, struct aesd_dev, cdev);
+    mutex_init(&file->lock);
+    file->working_cmd.head = NULL;
+    file->working_cmd.tail = NULL;
+    file->working_cmd.size = 0;
+    file->blocking = false;
+    spin_lock_init(&file->anchor_lock);
+    file->anchor_pos = -1;
+    file->anchor_stream_pos = 0;
+    filp->private_data = file;
+    filp->f_pos = 0;
+    /* read() and lseek() of a shared file take f_pos_lock, so they update f_pos and the anchor in turn */
+    filp->f_mode |= FMODE_ATOMIC_POS;
+    return 0;
+}
+
+int aesd_release(struct inode *inode, struct file *filp)
+{
+    PDEBUG("release");
+    struct aesd_file *file = filp->private_data;
+    struct aesd_dev *dev = file->dev;
+
+    /* Leave an unfinished command to the next write to the device, as if written through one file */
+    if (file->working_cmd.head != NULL) {
+        mutex_lock(&dev->lock);
+        aesd_command_join(&dev->partial_cmd, &file->working_cmd);
+        mutex_unlock(&dev->lock);
+    }
+    mutex_destroy(&file->lock);
+    kfree(file);
+    filp->private_data = NULL;
+    return 0;
+}
+
+/**
+ * Finds the byte which the position @param pos of @param filp stands for now. Positions count from
+ * the oldest command. The file position, as last set by a read or seek, is moved along with its
+ * byte as older commands are evicted, and restarts at the oldest command once its byte is evicted
+ * too, so a reader at the end of the buffer goes on with the commands added since. Any other
+ * position, such as the offset of a pread(), is taken as it is.
+ * @param total_size set to the number of bytes in the buffer
+ * @param stream_pos set to the stream position of the byte
+ * @return the current position of the byte
+ */
+static loff_t aesd_file_pos(struct file *filp, loff_t pos, size_t *total_size, size_t *stream_pos)
+{
+    struct aesd_file *file = filp->private_data;
+    struct aesd_dev *dev = file->dev;
+    unsigned int seq;
+    size_t anchor_stream_pos = 0;
+    bool anchored = false;
+    size_t offset;
+    size_t total;
+    size_t base;
+
+    do {
+        seq = read_seqcount_begin(&dev->seq);
+        total = READ_ONCE(dev->circ_buf.total_size);
+        base = READ_ONCE(dev->circ_buf.bytes_added) - total;
+    } while (read_seqcount_retry(&dev->seq, seq));
+
+    if (pos == READ_ONCE(filp->f_pos)) {
+        spin_lock(&file->anchor_lock);
+        if (pos == file->anchor_pos) {
+            anchored = true;
+            anchor_stream_pos = file->anchor_stream_pos;
+        }
+        spin_unlock(&file->anchor_lock);
+    }
+    if (anchored) {
+        /* Wraps to a large offset if the byte was evicted */
+        offset = anchor_stream_pos - base;
+        pos = (offset <= total) ? offset : 0;
+    }
+    *total_size = total;
+    *stream_pos = base + pos;
+    return pos;
+}
+
+/**
+ * Records that the file position @param pos of @param file stands for the byte at @param stream_pos,
+ * see aesd_file_pos()
+ */
+static void aesd_file_anchor(struct aesd_file *file, loff_t pos, size_t stream_pos)
+{
+    spin_lock(&file->anchor_lock);
+    file->anchor_pos = pos;
+    file->anchor_stream_pos = stream_pos;
+    spin_unlock(&file->anchor_lock);
+}
+
+/**
+ * @return true if a read of @param filp at @param pos would return data right away
+ */
+bool aesd_file_readable(struct file *filp, loff_t pos)
+{
+    size_t total_size;
+    size_t stream_pos;
+
+    return aesd_file_pos(filp, pos, &total_size, &stream_pos) < total_size;
+}
+
+/**
+ * Allocates the mapping of @param dev: one header page followed by a ring of @param mmap_size
+ * bytes, zeroed so no stale kernel memory ever reaches user space
+ * @return 0 on success or if mmap is disabled, -ENOMEM
+ */
+static int aesd_mmap_alloc(struct aesd_dev *dev, size_t mmap_size)
+{
+    size_t size;
+
+    if (mmap_size == 0)
+        return 0;
+    size = roundup_pow_of_two(PAGE_ALIGN(mmap_size));
+    dev->mmap_header = vmalloc_user(PAGE_SIZE + size);
+    if (dev->mmap_header == NULL)
+        return -ENOMEM;
+    dev->mmap_header->magic = AESD_MMAP_MAGIC;
+    dev->mmap_header->data_offset = PAGE_SIZE;
+    dev->mmap_header->data_size = size;
+    dev->mmap_data = (char *)dev->mmap_header + PAGE_SIZE;
+    dev->mmap_data_size = size;
+    return 0;
+}
+
+/**
+ * Starts a change to the circular buffer of @param dev, with dev->lock held. Lockless readers
+ * of the buffer retry through dev->seq, readers of the mapping through its own seq.
+ */
+static void aesd_buffer_write_begin(struct aesd_dev *dev)
+{
+    struct aesd_mmap_header *header = dev->mmap_header;
+
+    write_seqcount_begin(&dev->seq);
+    if (header != NULL) {
+        WRITE_ONCE(header->seq, header->seq + 1);
+        smp_wmb();
+    }
+}
+
+/**
+ * Ends a change started with aesd_buffer_write_begin(), publishing the new state of the buffer
+ * in the header page of the mapping
+ */
+static void aesd_buffer_write_end(struct aesd_dev *dev)
+{
+    struct aesd_mmap_header *header = dev->mmap_header;
+    struct aesd_circular_buffer *buffer = &dev->circ_buf;
+
+    if (header != NULL) {
+        header->stream_end = buffer->bytes_added;
+        header->total_size = buffer->total_size;
+        header->count = buffer->count;
+        header->depth = buffer->depth;
+        header->in_offs = buffer->in_offs;
+        header->out_offs = buffer->out_offs;
+        smp_wmb();
+        WRITE_ONCE(header->seq, header->seq + 1);
+    }
+    write_seqcount_end(&dev->seq);
+}
+
+/**
+ * Copies the command @param buffptr of @param size bytes, about to be added to the buffer of
+ * @param dev, to the data ring of the mapping. Only its last bytes are kept if it is larger than
+ * the ring. Must be called between aesd_buffer_write_begin() and aesd_buffer_write_end().
+ */
+static void aesd_mmap_append(struct aesd_dev *dev, const char *buffptr, size_t size)
+{
+    size_t mask = dev->mmap_data_size - 1;
+    size_t offset = 0;
+    size_t pos;
+    size_t n;
+
+    if (dev->mmap_header == NULL)
+        return;
+    if (size > dev->mmap_data_size)
+        offset = size - dev->mmap_data_size;
+
+    /* At most two copies, the second one once the ring wraps */
+    while (offset < size) {
+        pos = (dev->circ_buf.bytes_added + offset) & mask;
+        n = min(size - offset, dev->mmap_data_size - pos);
+        aesd_command_copy(buffptr, offset, dev->mmap_data + pos, n);
+        offset += n;
+    }
+}
+
+/**
+ * Looks up the command holding a byte of @param dev without taking dev->lock.
+ * Must be called within an aesd_srcu read side section, which keeps the command alive.
+ * @param pos the file position of the byte, or its stream position if @param stream is set
+ *      (see aesd_circular_buffer_find_entry_offset_for_stream_pos())
+ * @param entry_offset set to the offset of the byte within the command
+ * @param available set to the number of bytes of the command from the byte on
+ * @param stream_pos set to the stream position of the byte
+ * @return the buffptr of the command, or NULL if the byte is not in the buffer
+ */
+static const char *aesd_find_command(struct aesd_dev *dev, size_t pos, bool stream, size_t *entry_offset,
+                size_t *available, size_t *stream_pos)
+{
+    struct aesd_buffer_entry *entry;
+    const char *buffptr;
+    unsigned int seq;
+
+    do {
+        seq = read_seqcount_begin(&dev->seq);
+        buffptr = NULL;
+        if (stream)
+            entry = aesd_circular_buffer_find_entry_offset_for_stream_pos(&dev->circ_buf, pos, entry_offset);
+        else
+            entry = aesd_circular_buffer_find_entry_offset_for_fpos(&dev->circ_buf, pos, entry_offset);
+        if (entry != NULL) {
+            buffptr = READ_ONCE(entry->buffptr);
+            *available = READ_ONCE(entry->size) - *entry_offset;
+            *stream_pos = READ_ONCE(entry->start) + *entry_offset;
+        }
+    } while (read_seqcount_retry(&dev->seq, seq));
+
+    return buffptr;
+}
+
+/**
+ * Reads from @param filp at @param f_pos into @param to, advancing f_pos
+ * @return the number of bytes read, or a negative error if none were
+ */
+static ssize_t aesd_read_to(struct file *filp, struct iov_iter *to, loff_t *f_pos)
+{
+    ssize_t retval = 0;
+    size_t entry_offset;
+    size_t available;
+    size_t stream_pos = 0;
+    const char *buffptr;
+    size_t bytes_read = 0;
+    size_t count = iov_iter_count(to);
+    size_t copied;
+    struct aesd_file *file = filp->private_data;
+    struct aesd_dev *dev = file->dev;
+    /* Only a read at the file position, a read() rather than a pread(), moves the anchor */
+    bool sequential = *f_pos == READ_ONCE(filp->f_pos);
+    size_t total_size;
+    loff_t pos;
+    int idx;
+
+    pos = aesd_file_pos(filp, *f_pos, &total_size, &stream_pos);
+    while (pos >= total_size && file->blocking)
+    {
+        /* Wait for the next command rather than report the end of the buffer */
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(dev->wq,
+                    aesd_file_pos(filp, *f_pos, &total_size, &stream_pos) < total_size))
+            return -ERESTARTSYS;
+        pos = aesd_file_pos(filp, *f_pos, &total_size, &stream_pos);
+    }
+
+    /*
+     * Fill the buffers of the read from as many consecutive entries as fit, all in one read side
+     * section, however many buffers there are. Entries are found by stream position, so commands
+     * evicted meanwhile end the read rather than shift what it returns.
+     */
+    idx = srcu_read_lock(&aesd_srcu);
+    while (bytes_read < count)
+    {
+        buffptr = aesd_find_command(dev, stream_pos, true, &entry_offset, &available, &stream_pos);
+        if (buffptr == NULL && bytes_read == 0 && pos < total_size)
+        {
+            /* The first byte was evicted since it was found, look again from where pos stands now */
+            pos = aesd_file_pos(filp, *f_pos, &total_size, &stream_pos);
+            continue;
+        }
+        if (buffptr == NULL)
+            break;
+        if (available > count - bytes_read)
+            available = count - bytes_read;
+
+        copied = aesd_command_copy_to_iter(buffptr, entry_offset, to, available);
+        bytes_read += copied;
+        stream_pos += copied;
+        if (copied < available)
+        {
+            /* Report what was copied before the fault, if anything */
+            if (bytes_read == 0)
+                retval = -EFAULT;
+            break;
+        }
+    }
+    srcu_read_unlock(&aesd_srcu, idx);
+
+    if (retval == 0)
+    {
+        *f_pos = pos + bytes_read;
+        retval = bytes_read;
+        if (sequential && (bytes_read > 0 || pos <= total_size))
+            aesd_file_anchor(file, *f_pos, stream_pos);
+    }
+
+    return retval;
+}
+
+ssize_t aesd_read(struct file *filp, char __user *buf, size_t count,
+                loff_t *f_pos)
+{
+    struct iovec iov = { .iov_base = buf, .iov_len = count };
+    struct iov_iter to;
+
+    PDEBUG("read %zu bytes with offset %lld",count,*f_pos);
+    iov_iter_init(&to, ITER_DEST, &iov, 1, count);
+    return aesd_read_to(filp, &to, f_pos);
+}
+
+ssize_t aesd_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    PDEBUG("read_iter %zu bytes with offset %lld", iov_iter_count(to), iocb->ki_pos);
+    return aesd_read_to(iocb->ki_filp, to, &iocb->ki_pos);
+}
+
+/**
+ * Frees a command evicted from the buffer of the aesd_dev @param ctx once the readers of
+ * aesd_srcu are done with it
+ */
+static void aesd_evict(const char *buffptr, void *ctx)
+{
+    struct aesd_dev *dev = ctx;
+
+    dev->mem_size -= aesd_command_footprint(buffptr);
+    aesd_command_free_deferred(buffptr, &aesd_srcu);
+}
+
+/**
+ * Evicts the oldest command of @param dev
+ */
+static void aesd_evict_oldest(struct aesd_dev *dev)
+{
+    aesd_evict(aesd_circular_buffer_remove_oldest(&dev->circ_buf), dev);
+}
+
+/**
+ * Commits the @param n complete commands of @param batch to the buffer of @param dev in order,
+ * under one acquisition of dev->lock, and wakes the readers waiting for them
+ */
+static void aesd_commit(struct aesd_dev *dev, const struct aesd_buffer_entry *batch, unsigned int n)
+{
+    unsigned int i;
+    size_t footprint;
+
+    if (n == 0)
+        return;
+
+    /* The data is accepted already, so don't let a signal drop the commands */
+    mutex_lock(&dev->lock);
+    aesd_buffer_write_begin(dev);
+    for (i = 0; i < n; i++) {
+        aesd_mmap_append(dev, batch[i].buffptr, batch[i].size);
+        /* The limit is on the memory commands hold, which short commands make far more than their bytes */
+        footprint = aesd_command_footprint(batch[i].buffptr);
+        while (dev->max_size != 0 && dev->circ_buf.count > 0 && dev->mem_size + footprint > dev->max_size)
+            aesd_evict_oldest(dev);
+        dev->mem_size += footprint;
+        /* The command a full buffer overwrites goes to aesd_evict() */
+        aesd_circular_buffer_add_entry(&dev->circ_buf, &batch[i]);
+    }
+    aesd_buffer_write_end(dev);
+    mutex_unlock(&dev->lock);
+
+    wake_up_interruptible(&dev->wq);
+}
+
+/**
+ * Adds the complete working command of @param file to @param batch, committing the batch to the
+ * buffer once it is full
+ */
+void aesd_batch_add(struct aesd_file *file, struct aesd_write_batch *batch)
+{
+    batch->entry[batch->count].size = file->working_cmd.size;
+    batch->entry[batch->count].buffptr = aesd_command_finish(&file->working_cmd);
+    if (++batch->count == AESD_WRITE_BATCH) {
+        aesd_commit(file->dev, batch->entry, batch->count);
+        batch->count = 0;
+    }
+}
+
+/**
+ * Starts a write through @param file, taking file->lock
+ * @return 0 on success, -ERESTARTSYS
+ */
+int aesd_write_begin(struct aesd_file *file, struct aesd_write_batch *batch)
+{
+    struct aesd_dev *dev = file->dev;
+
+    /* Partial commands are private to the file, only committing one needs the device lock */
+    if (mutex_lock_interruptible(&file->lock))
+        return -ERESTARTSYS;
+
+    /* Pick up the command a closed file left unfinished, see aesd_release() */
+    if (file->working_cmd.head == NULL && READ_ONCE(dev->partial_cmd.head) != NULL)
+    {
+        if (mutex_lock_interruptible(&dev->lock)) {
+            mutex_unlock(&file->lock);
+            return -ERESTARTSYS;
+        }
+        aesd_command_join(&file->working_cmd, &dev->partial_cmd);
+        mutex_unlock(&dev->lock);
+    }
+
+    batch->count = 0;
+    return 0;
+}
+
+/**
+ * Ends a write started with aesd_write_begin(), committing the rest of @param batch
+ */
+void aesd_write_end(struct aesd_file *file, struct aesd_write_batch *batch)
+{
+    aesd_commit(file->dev, batch->entry, batch->count);
+    mutex_unlock(&file->lock);
+}
+
+/**
+ * Writes @param from through @param file. Every complete command is committed, and a trailing
+ * partial command is kept for the next write.
+ * @return the number of bytes written, or a negative error if none were
+ */
+static ssize_t aesd_write_from(struct aesd_file *file, struct iov_iter *from)
+{
+    struct aesd_write_batch batch;
+    size_t done = 0;
+    ssize_t retval;
+    bool complete;
+
+    retval = aesd_write_begin(file, &batch);
+    if (retval)
+        return retval;
+
+    /* Copy the data straight into the storage of the working command one command at a time */
+    while (iov_iter_count(from) > 0)
+    {
+        retval = aesd_command_append(&file->working_cmd, from, &complete);
+        if (retval <= 0)
+            break;
+        done += retval;
+        if (complete)
+            aesd_batch_add(file, &batch);
+    }
+
+    aesd_write_end(file, &batch);
+
+    /* Report what was accepted before a failure, if anything */
+    return done ? done : retval;
+}
+
+ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos)
+{
+    struct iovec iov = { .iov_base = (void __user *)buf, .iov_len = count };
+    struct iov_iter from;
+    PDEBUG("write %zu bytes with offset %lld",count,*f_pos);
+
+    iov_iter_init(&from, ITER_SOURCE, &iov, 1, count);
+    return aesd_write_from(filp->private_data, &from);
+}
+
+ssize_t aesd_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    PDEBUG("write_iter %zu bytes", iov_iter_count(from));
+    return aesd_write_from(iocb->ki_filp->private_data, from);
+}
+
+loff_t aesd_llseek(struct file *filp, loff_t offset, int whence)
+{
+    struct aesd_file *file = filp->private_data;
+    loff_t newpos;
+    loff_t pos;
+    size_t total_size;
+    size_t stream_pos;
+
+    pos = aesd_file_pos(filp, filp->f_pos, &total_size, &stream_pos);
+
+    switch (whence) {
+    case SEEK_SET:
+        newpos = offset;
+        break;
+    case SEEK_CUR:
+        newpos = pos + offset;
+        break;
+    case SEEK_END:
+        newpos = (loff_t)total_size + offset;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    if (newpos < 0)
+        return -EINVAL;
+
+    filp->f_pos = newpos;
+    if (newpos <= (loff_t)total_size)
+        aesd_file_anchor(file, newpos, stream_pos - pos + newpos);
+    return newpos;
+}
+
+/*
+ * A slot array replaced by aesd_set_depth(), freed once the readers still using it are done
+ */
+struct aesd_retired_slots
+{
+    struct rcu_head rcu;
+    struct aesd_buffer_entry *slots;
+};
+
+static void aesd_retired_slots_free(struct rcu_head *rcu)
+{
+    struct aesd_retired_slots *retired = container_of(rcu, struct aesd_retired_slots, rcu);
+
+    kfree(retired->slots);
+    kfree(retired);
+}
+
+/**
+ * Changes the number of commands kept by @param dev to @param depth, freeing the oldest ones
+ * which no longer fit
+ * @return 0 on success, -EINVAL for an unsupported depth, -ENOMEM or -ERESTARTSYS
+ */
+static long aesd_set_depth(struct aesd_dev *dev, unsigned int depth)
+{
+    struct aesd_buffer_entry *slots;
+    struct aesd_retired_slots *retired;
+    unsigned int nslots;
+    long retval = 0;
+
+    if (depth == 0 || depth > AESDCHAR_MAX_DEPTH)
+        return -EINVAL;
+
+    nslots = roundup_pow_of_two(depth);
+    slots = kcalloc(nslots, sizeof(*slots), GFP_KERNEL);
+    retired = kmalloc(sizeof(*retired), GFP_KERNEL);
+    if (slots == NULL || retired == NULL) {
+        retval = -ENOMEM;
+        goto out_free;
+    }
+
+    if (mutex_lock_interruptible(&dev->resize_lock)) {
+        retval = -ERESTARTSYS;
+        goto out_free;
+    }
+    if (mutex_lock_interruptible(&dev->lock)) {
+        mutex_unlock(&dev->resize_lock);
+        retval = -ERESTARTSYS;
+        goto out_free;
+    }
+
+    /* Evict the oldest commands which no longer fit */
+    aesd_buffer_write_begin(dev);
+    while (dev->circ_buf.count > depth)
+        aesd_evict_oldest(dev);
+    if (nslots < dev->circ_buf.mask + 1) {
+        aesd_circular_buffer_compact(&dev->circ_buf, nslots, depth);
+        aesd_buffer_write_end(dev);
+
+        /*
+         * Readers still indexing the current array with its larger mask must be done before it is
+         * replaced. Writers go on meanwhile, the compacted buffer already keeps depth commands.
+         */
+        mutex_unlock(&dev->lock);
+        synchronize_srcu(&aesd_srcu);
+        mutex_lock(&dev->lock);
+        aesd_buffer_write_begin(dev);
+    }
+
+    retired->slots = aesd_circular_buffer_resize(&dev->circ_buf, slots, nslots, depth);
+    aesd_buffer_write_end(dev);
+    mutex_unlock(&dev->lock);
+    mutex_unlock(&dev->resize_lock);
+
+    if (retired->slots == NULL)
+        kfree(retired);
+    else
+        call_srcu(&aesd_srcu, &retired->rcu, aesd_retired_slots_free);
+    return 0;
+
+out_free:
+    kfree(slots);
+    kfree(retired);
+    return retval;
+}
+
+/**
+ * Changes the number of bytes of memory the commands kept by @param dev may hold to
+ * @param max_size, 0 for no limit, freeing the oldest commands which no longer fit. The newest
+ * command is always kept.
+ * @return 0 on success, -EINVAL for a size beyond the address space, or -ERESTARTSYS
+ */
+static long aesd_set_max_size(struct aesd_dev *dev, uint64_t max_size)
+{
+    if (max_size > SIZE_MAX)
+        return -EINVAL;
+    if (mutex_lock_interruptible(&dev->lock))
+        return -ERESTARTSYS;
+
+    aesd_buffer_write_begin(dev);
+    WRITE_ONCE(dev->max_size, max_size);
+    while (max_size != 0 && dev->circ_buf.count > 1 && dev->mem_size > max_size)
+        aesd_evict_oldest(dev);
+    aesd_buffer_write_end(dev);
+
+    mutex_unlock(&dev->lock);
+    return 0;
+}
+
+/**
+ * Moves the file position of @param filp to the command and offset described by @param seekto
+ * @return 0 on success, -EINVAL if the command or offset is not in the buffer
+ */
+static long aesd_seekto(struct file *filp, struct aesd_dev *dev, const struct aesd_seekto *seekto)
+{
+    struct aesd_circular_buffer *buffer = &dev->circ_buf;
+    unsigned int seq;
+    bool stored;
+    size_t start;
+    size_t end;
+    size_t base;
+    int idx;
+
+    /* The command spans from its own start to the start of the next one */
+    idx = srcu_read_lock(&aesd_srcu);
+    do {
+        seq = read_seqcount_begin(&dev->seq);
+        stored = seekto->write_cmd < READ_ONCE(buffer->count);
+        start = aesd_circular_buffer_fpos_of_entry(buffer, seekto->write_cmd);
+        end = aesd_circular_buffer_fpos_of_entry(buffer, seekto->write_cmd + 1);
+        base = READ_ONCE(buffer->bytes_added) - READ_ONCE(buffer->total_size);
+    } while (read_seqcount_retry(&dev->seq, seq));
+    srcu_read_unlock(&aesd_srcu, idx);
+
+    if (!stored || (seekto->write_cmd_offset > end - start))
+        return -EINVAL;
+
+    /* Update the file position with the computed offset */
+    filp->f_pos = start + seekto->write_cmd_offset;
+    aesd_file_anchor(filp->private_data, filp->f_pos, base + filp->f_pos);
+    return 0;
+}
+
+long aesd_unlocked_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    struct aesd_file *file = filp->private_data;
+    struct aesd_dev *dev = file->dev;
+    struct aesd_seekto seekto;
+    uint32_t blocking;
+    uint32_t depth;
+    uint64_t max_size;
+
+    switch (cmd) {
+    case AESDCHAR_IOCSEEKTO:
+        if (copy_from_user(&seekto, (struct aesd_seekto*) arg, sizeof(struct aesd_seekto)))
+            return -EFAULT;
+        return aesd_seekto(filp, dev, &seekto);
+
+    case AESDCHAR_IOCSETDEPTH:
+        if (copy_from_user(&depth, (uint32_t __user *) arg, sizeof(depth)))
+            return -EFAULT;
+        return aesd_set_depth(dev, depth);
+
+    case AESDCHAR_IOCGETDEPTH:
+        depth = READ_ONCE(dev->circ_buf.depth);
+        if (copy_to_user((uint32_t __user *) arg, &depth, sizeof(depth)))
+            return -EFAULT;
+        return 0;
+
+    case AESDCHAR_IOCSETBLOCKING:
+        if (copy_from_user(&blocking, (uint32_t __user *) arg, sizeof(blocking)))
+            return -EFAULT;
+        file->blocking = blocking != 0;
+        return 0;
+
+    case AESDCHAR_IOCSETMAXSIZE:
+        if (copy_from_user(&max_size, (uint64_t __user *) arg, sizeof(max_size)))
+            return -EFAULT;
+        return aesd_set_max_size(dev, max_size);
+
+    case AESDCHAR_IOCGETMAXSIZE:
+        max_size = READ_ONCE(dev->max_size);
+        if (copy_to_user((uint64_t __user *) arg, &max_size, sizeof(max_size)))
+            return -EFAULT;
+        return 0;
+
+    default:
+        return -ENOTTY;
+    }
+}
+
+/**
+ * Initializes @param dev with an empty buffer keeping @param depth commands holding up to
+ * @param max_bytes bytes of memory (0 for no limit), readable through a mapping of
+ * @param mmap_size bytes (0 for none)
+ * @return 0 on success, -ENOMEM or -EINVAL for an unsupported depth
+ */
+int aesd_dev_init(struct aesd_dev *dev, unsigned int depth, size_t max_bytes, size_t mmap_size)
+{
+    int result;
+
+    mutex_init(&dev->lock);
+    mutex_init(&dev->resize_lock);
+    seqcount_mutex_init(&dev->seq, &dev->lock);
+    init_waitqueue_head(&dev->wq);
+    aesd_circular_buffer_init(&dev->circ_buf);
+    dev->circ_buf.evict = aesd_evict;
+    dev->circ_buf.evict_ctx = dev;
+    dev->max_size = max_bytes;
+    dev->mem_size = 0;
+    result = aesd_mmap_alloc(dev, mmap_size);
+    if (result) {
+        printk(KERN_ERR "Can't allocate %zu bytes for mmap of the aesdchar buffer\n", mmap_size);
+        return result;
+    }
+    if (depth != AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED) {
+        result = aesd_set_depth(dev, depth);
+        if (result) {
+            printk(KERN_ERR "Can't keep %u commands in the aesdchar buffer\n", depth);
+            vfree(dev->mmap_header);
+            return result;
+        }
+    }
+
+    /* No file has left a command unfinished yet */
+    dev->partial_cmd.head = NULL;
+    dev->partial_cmd.tail = NULL;
+    dev->partial_cmd.size = 0;
+    return 0;
+}
+
+/**
+ * Frees everything @param dev holds, once its cdev is gone and the frees deferred for readers
+ * have run
+ */
+void aesd_dev_free(struct aesd_dev *dev)
+{
+    int i = 0;
+    struct aesd_buffer_entry *entry;
+    AESD_CIRCULAR_BUFFER_FOREACH(entry, &dev->circ_buf, i) {
+        aesd_command_free(entry->buffptr);
+    }
+
+    if (dev->circ_buf.entry != dev->circ_buf.inline_entry)
+        kfree(dev->circ_buf.entry);
+    vfree(dev->mmap_header);
+
+    /* Free any data remaining in the unfinished command */
+    aesd_command_discard(&dev->partial_cmd);
+}
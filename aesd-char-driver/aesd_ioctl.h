@@ -33,14 +33,55 @@ struct aesd_seekto {
     uint32_t write_cmd_offset;
 };
 
+/**
+ * The first page of the read-only mapping of an aesd char device, followed by the data ring.
+ *
+ * Every byte ever written to the device has a stream position, counting from the first one. The
+ * bytes of the commands in the buffer are the total_size bytes before stream_end, and a byte at
+ * stream position pos is found at offset data_offset + (pos & (data_size - 1)) of the mapping,
+ * as long as stream_end - pos <= data_size. Positions only matter modulo data_size.
+ *
+ * The device updates the page and the ring while seq is odd. A consistent view is one taken
+ * between two reads of the same even seq:
+ *
+ *   do {
+ *       seq = header->seq;          (with acquire semantics, retry while odd)
+ *       ... copy fields and data ...
+ *   } while (header->seq != seq);   (after a read barrier)
+ */
+struct aesd_mmap_header {
+    uint32_t magic;         // AESD_MMAP_MAGIC
+    uint32_t seq;
+    uint32_t data_offset;   // Offset of the data ring in the mapping
+    uint32_t data_size;     // Size of the data ring, a power of two
+    uint64_t stream_end;    // Stream position one past the newest byte
+    uint64_t total_size;    // Bytes of all commands in the buffer, may exceed data_size
+    uint32_t count;         // Commands in the buffer
+    uint32_t depth;         // Commands kept by the buffer
+    uint32_t in_offs;       // Slot of the next command in the circular buffer
+    uint32_t out_offs;      // Slot of the oldest command in the circular buffer
+};
+
+#define AESD_MMAP_MAGIC 0x61657364
+
 // Pick an arbitrary unused value from https://github.com/torvalds/linux/blob/master/Documentation/userspace-api/ioctl/ioctl-number.rst
 #define AESD_IOC_MAGIC 0x16
 
 // Define a write command from the user point of view, use command number 1
 #define AESDCHAR_IOCSEEKTO _IOWR(AESD_IOC_MAGIC, 1, struct aesd_seekto)
+// Change the number of write commands kept by the device, evicting the oldest ones if it shrinks
+#define AESDCHAR_IOCSETDEPTH _IOW(AESD_IOC_MAGIC, 2, uint32_t)
+// Read the number of write commands kept by the device
+#define AESDCHAR_IOCGETDEPTH _IOR(AESD_IOC_MAGIC, 3, uint32_t)
+// Make reads of this file at the end of the buffer wait for the next command (non-zero) or return 0 (zero)
+#define AESDCHAR_IOCSETBLOCKING _IOW(AESD_IOC_MAGIC, 4, uint32_t)
+// Change the bytes of memory the write commands kept by the device may hold (0 for no limit), evicting the oldest ones
+#define AESDCHAR_IOCSETMAXSIZE _IOW(AESD_IOC_MAGIC, 5, uint64_t)
+// Read the bytes of memory the write commands kept by the device may hold
+#define AESDCHAR_IOCGETMAXSIZE _IOR(AESD_IOC_MAGIC, 6, uint64_t)
 /**
  * The maximum number of commands supported, used for bounds checking
  */
-#define AESDCHAR_IOC_MAXNR 1
+#define AESDCHAR_IOC_MAXNR 6
 
 #endif /* AESD_IOCTL_H */
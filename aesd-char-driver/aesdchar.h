@@ -9,8 +9,13 @@
 #define AESD_CHAR_DRIVER_AESDCHAR_H_
 
 #include "aesd-circular-buffer.h"
+#include "aesd-command.h"
+#include "aesd_ioctl.h"
 
+/* Userspace builds of the driver core leave it off, a benchmark would only print debug messages */
+#ifdef __KERNEL__
 #define AESD_DEBUG 1  //Remove comment on this line to enable debug
+#endif
 
 #undef PDEBUG             /* undef it, just in case */
 #ifdef AESD_DEBUG
@@ -25,13 +30,76 @@
 #  define PDEBUG(fmt, args...) /* not debugging: nothing */
 #endif
 
+/**
+ * The maximum number of devices (minors) the module can create
+ */
+#define AESDCHAR_MAX_DEVICES 256
+
 struct aesd_dev
 {
     struct cdev cdev;     /* Char device structure      */
-    struct mutex lock;             /* Mutex to protect accesses */
+    struct mutex lock;             /* Mutex serializing writers */
+    struct mutex resize_lock;      /* Serializes depth changes, which wait for readers without lock */
+    seqcount_mutex_t seq;          /* Lets readers validate their view of circ_buf without lock */
     struct aesd_circular_buffer circ_buf;  /* Circular buffer for write data */
-    struct aesd_buffer_entry working_entry;  /* Working entry for accumulating incomplete commands */
+    size_t max_size;               /* Bytes of memory the commands in circ_buf may hold, 0 for no limit */
+    size_t mem_size;               /* Bytes of memory held by the commands in circ_buf */
+    struct aesd_command partial_cmd;  /* Unfinished command of a closed file, continued by the next write */
+    struct aesd_mmap_header *mmap_header;  /* Header page of the mapping, followed by the data ring */
+    char *mmap_data;               /* Data ring holding the newest bytes of the commands */
+    size_t mmap_data_size;         /* Size of the data ring, 0 if mapping is disabled */
+    wait_queue_head_t wq;          /* Woken whenever a command is committed */
 };
 
+/*
+ * State of one open file of an aesd device
+ */
+struct aesd_file
+{
+    struct aesd_dev *dev;
+    struct mutex lock;             /* Serializes writes through this file */
+    struct aesd_command working_cmd;  /* Working command for accumulating incomplete writes */
+    bool blocking;                 /* Reads at the end of the buffer wait for the next command */
+    spinlock_t anchor_lock;        /* Guards the anchor against concurrent pread() */
+    loff_t anchor_pos;             /* Last file position set by a read or seek, -1 if none */
+    size_t anchor_stream_pos;      /* Stream position of the byte anchor_pos stood for then */
+};
+
+/**
+ * Number of complete commands a write collects before committing them to the buffer
+ */
+#define AESD_WRITE_BATCH 16
+
+/*
+ * Complete commands collected by a write, committed together
+ */
+struct aesd_write_batch
+{
+    struct aesd_buffer_entry entry[AESD_WRITE_BATCH];
+    unsigned int count;
+};
+
+/*
+ * Driver core, aesd-core.c
+ */
+extern struct srcu_struct aesd_srcu;
+
+extern int aesd_dev_init(struct aesd_dev *dev, unsigned int depth, size_t max_bytes, size_t mmap_size);
+extern void aesd_dev_free(struct aesd_dev *dev);
+
+extern int aesd_open(struct inode *inode, struct file *filp);
+extern int aesd_release(struct inode *inode, struct file *filp);
+extern ssize_t aesd_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos);
+extern ssize_t aesd_read_iter(struct kiocb *iocb, struct iov_iter *to);
+extern ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos);
+extern ssize_t aesd_write_iter(struct kiocb *iocb, struct iov_iter *from);
+extern loff_t aesd_llseek(struct file *filp, loff_t offset, int whence);
+extern long aesd_unlocked_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+
+extern bool aesd_file_readable(struct file *filp, loff_t pos);
+extern int aesd_write_begin(struct aesd_file *file, struct aesd_write_batch *batch);
+extern void aesd_batch_add(struct aesd_file *file, struct aesd_write_batch *batch);
+extern void aesd_write_end(struct aesd_file *file, struct aesd_write_batch *batch);
+
 
 #endif /* AESD_CHAR_DRIVER_AESDCHAR_H_ */
@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    aesd-circular-buffer-bench.c
+ * @brief   This file implements a microbenchmark of aesd_circular_buffer_add_entry() and
+ *          aesd_circular_buffer_find_entry_offset_for_fpos().
+ *
+ * Every combination of buffer depth and entry size distribution is measured on its own buffer:
+ * adds into the full buffer, which evict the oldest entry each time, then lookups of a sequential
+ * scan from the oldest entry on, of random positions, and of positions in its newest entries (tail
+ * reads). Sizes and positions are generated before timing starts, and each measurement is
+ * repeated, keeping the fastest run.
+ *
+ * The results are printed as a single JSON object on stdout, one result per line, in cycles per
+ * operation: time stamp counter ticks on x86, nanoseconds elsewhere ("counter" says which).
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "../aesd-circular-buffer.h"
+
+#define DEFAULT_OPS (1 << 20)
+#define DEFAULT_REPEATS 3
+#define PATTERN_SIZE 4096           // Precomputed sizes and positions, cycled through by index
+#define SCAN_STRIDE 61              // Bytes between the positions of a sequential scan
+#define TAIL_BYTES 512              // Tail reads land in the last TAIL_BYTES bytes of the buffer
+#define NSEC_PER_SEC 1000000000ULL
+
+static const unsigned int depths[] = { AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, 64, 1024, 16384, AESDCHAR_MAX_DEPTH };
+
+/* Entry sizes, as written by the clients of aesdsocket */
+enum size_dist {
+    SIZE_FIXED,                     // Every entry 64 bytes
+    SIZE_UNIFORM,                   // 1 to 1024 bytes
+    SIZE_BIMODAL,                   // Mostly 32 byte entries, one in ten 4096 bytes
+    SIZE_DIST_COUNT,
+};
+
+static const char *const size_dist_names[] = { "fixed", "uniform", "bimodal" };
+
+enum access_pattern {
+    ACCESS_SCAN,
+    ACCESS_RANDOM,
+    ACCESS_TAIL,
+    ACCESS_PATTERN_COUNT,
+};
+
+static const char *const access_pattern_names[] = { "sequential_scan", "random_seek", "tail_read" };
+
+/* Stands in for the data of every entry, which the buffer never reads */
+static const char entry_data[1];
+
+/* Keeps the compiler from dropping lookups whose result is otherwise unused */
+static volatile size_t sink;
+
+static int first_result = 1;
+
+/*
+ * Returns the current value of the cycle counter.
+ */
+static uint64_t counter_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+/*
+ * Returns the next number of a xorshift generator, seeded per measurement so runs are repeatable.
+ */
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static size_t entry_size(enum size_dist dist, uint64_t *state)
+{
+    uint64_t r = next_random(state);
+
+    switch (dist) {
+    case SIZE_UNIFORM:
+        return 1 + r % 1024;
+    case SIZE_BIMODAL:
+        return (r % 10 == 0) ? 4096 : 32;
+    default:
+        return 64;
+    }
+}
+
+/*
+ * Sets up @param buffer to keep @param depth entries, with slots of its own unless the inline
+ * ones are enough.
+ *
+ * Returns:
+ *   The slot array for the caller to free, NULL if the inline slots are used or on failure
+ */
+static struct aesd_buffer_entry *buffer_setup(struct aesd_circular_buffer *buffer, unsigned int depth)
+{
+    struct aesd_buffer_entry *slots;
+    unsigned int nslots = 1;
+
+    aesd_circular_buffer_init(buffer);
+    if (depth <= AESD_CIRCULAR_BUFFER_INLINE_SLOTS) {
+        buffer->depth = depth;
+        return NULL;
+    }
+    while (nslots < depth) {
+        nslots <<= 1;
+    }
+    slots = calloc(nslots, sizeof(*slots));
+    if (slots != NULL) {
+        aesd_circular_buffer_resize(buffer, slots, nslots, depth);
+    }
+    return slots;
+}
+
+static void print_result(const char *op, const char *pattern, unsigned int depth, enum size_dist dist,
+                         const struct aesd_circular_buffer *buffer, double cycles)
+{
+    printf("%s\n  {\"op\": \"%s\", \"pattern\": \"%s\", \"depth\": %u, \"sizes\": \"%s\", "
+           "\"total_size\": %zu, \"cycles_per_op\": %.1f}",
+           first_result ? "" : ",", op, pattern, depth, size_dist_names[dist], buffer->total_size, cycles);
+    first_result = 0;
+}
+
+/*
+ * Measures adds into the full buffer, then lookups with every access pattern, for one depth and
+ * size distribution.
+ *
+ * Returns:
+ *   0 on success, -1 if memory ran out
+ */
+static int bench_one(unsigned int depth, enum size_dist dist, unsigned long ops, unsigned int repeats)
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry *slots;
+    struct aesd_buffer_entry entries[PATTERN_SIZE];
+    size_t positions[PATTERN_SIZE];
+    struct aesd_buffer_entry *found;
+    uint64_t state = 0x9e3779b97f4a7c15ULL ^ depth ^ ((uint64_t)dist << 32);
+    uint64_t start;
+    uint64_t elapsed;
+    uint64_t best;
+    size_t offset;
+    size_t pos;
+    unsigned long i;
+    unsigned int r;
+    int pattern;
+
+    slots = buffer_setup(&buffer, depth);
+    if (slots == NULL && depth > AESD_CIRCULAR_BUFFER_INLINE_SLOTS) {
+        return -1;
+    }
+    for (i = 0; i < PATTERN_SIZE; i++) {
+        entries[i].buffptr = entry_data;
+        entries[i].size = entry_size(dist, &state);
+    }
+
+    /* Fill the buffer so every timed add evicts, as it does once a device has been running */
+    for (i = 0; i < depth; i++) {
+        aesd_circular_buffer_add_entry(&buffer, &entries[i % PATTERN_SIZE]);
+    }
+
+    best = UINT64_MAX;
+    for (r = 0; r < repeats; r++) {
+        start = counter_now();
+        for (i = 0; i < ops; i++) {
+            aesd_circular_buffer_add_entry(&buffer, &entries[i % PATTERN_SIZE]);
+        }
+        elapsed = counter_now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    print_result("add_entry", "append", depth, dist, &buffer, (double)best / ops);
+
+    for (pattern = 0; pattern < ACCESS_PATTERN_COUNT; pattern++) {
+        pos = 0;
+        for (i = 0; i < PATTERN_SIZE; i++) {
+            switch (pattern) {
+            case ACCESS_SCAN:
+                positions[i] = pos;
+                pos = (pos + SCAN_STRIDE) % buffer.total_size;
+                break;
+            case ACCESS_RANDOM:
+                positions[i] = next_random(&state) % buffer.total_size;
+                break;
+            default:
+                offset = buffer.total_size < TAIL_BYTES ? buffer.total_size : TAIL_BYTES;
+                positions[i] = buffer.total_size - 1 - next_random(&state) % offset;
+                break;
+            }
+        }
+
+        best = UINT64_MAX;
+        for (r = 0; r < repeats; r++) {
+            start = counter_now();
+            for (i = 0; i < ops; i++) {
+                found = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer,
+                            positions[i % PATTERN_SIZE], &offset);
+                sink += (size_t)found + offset;
+            }
+            elapsed = counter_now() - start;
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+        print_result("find_entry_offset_for_fpos", access_pattern_names[pattern], depth, dist, &buffer,
+                     (double)best / ops);
+    }
+
+    free(slots);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n ops] [-r repeats]\n"
+            "  -n  Operations per measurement (default %d)\n"
+            "  -r  Runs per measurement, the fastest one is reported (default %d)\n",
+            prog, DEFAULT_OPS, DEFAULT_REPEATS);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long ops = DEFAULT_OPS;
+    unsigned int repeats = DEFAULT_REPEATS;
+    unsigned int d;
+    int dist;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            ops = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            repeats = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (ops == 0 || repeats == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("{\"counter\": \"tsc\", \"ops\": %lu, \"repeats\": %u, \"results\": [", ops, repeats);
+#else
+    printf("{\"counter\": \"ns\", \"ops\": %lu, \"repeats\": %u, \"results\": [", ops, repeats);
+#endif
+    for (d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        for (dist = 0; dist < SIZE_DIST_COUNT; dist++) {
+            if (bench_one(depths[d], dist, ops, repeats) != 0) {
+                fprintf(stderr, "Failed to allocate %u slots\n", depths[d]);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    printf("\n]}\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,362 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    aesdchar-core-bench.c
+ * @brief   This file implements a throughput benchmark for the aesdchar driver core, built in
+ *          userspace on the stand-ins of userspace/kernel-shim.h.
+ *
+ * One device is set up in process, and every thread opens it through aesd_open() as a file of
+ * its own. Writer threads write whole commands of the form "W<writer>:<seq>:<padding>\n" with
+ * aesd_write(), reader threads read the whole buffer from the start with aesd_read() and check
+ * that every command in it is intact, and seeker threads alternate SEEK_END, SEEK_SET and
+ * AESDCHAR_IOCSEEKTO. No system call is made on the hot path, so the numbers measure the
+ * locking, lookups and copies of the driver itself.
+ *
+ * The results are printed as a single JSON object on stdout. The exit status is non-zero if any
+ * command read back was corrupt or any call failed.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "../userspace/kernel-shim.h"
+#include "../aesdchar.h"
+
+#define COMMAND_HEADER_MAX 32       // "W<writer>:<seq>:" with two 32 bit numbers
+#define NSEC_PER_SEC 1000000000ULL
+
+/* Benchmark settings shared by all threads */
+struct bench_config {
+    unsigned int readers;
+    unsigned int writers;
+    unsigned int seekers;
+    unsigned int seconds;
+    unsigned int depth;
+    size_t max_bytes;
+    size_t mmap_size;
+    size_t command_size;        // Bytes per command, including the newline
+};
+
+/* Counters of all threads */
+struct bench_result {
+    atomic_ulong writes;
+    atomic_ulong write_bytes;
+    atomic_ulong reads;
+    atomic_ulong read_bytes;
+    atomic_ulong seeks;
+    atomic_ulong corrupt;
+    atomic_ulong errors;
+};
+
+/* Structure to hold the state of one thread */
+struct bench_thread {
+    pthread_t thread_id;
+    unsigned int id;
+    const struct bench_config *cfg;
+    struct inode *inode;
+};
+
+static struct bench_result result;
+static atomic_int stop;
+
+/*
+ * Returns the padding character at position i of the command seq of writer.
+ */
+static char padding_char(unsigned int writer, unsigned long seq, size_t i)
+{
+    return 'a' + (writer * 7 + seq * 3 + i) % 26;
+}
+
+static void *writer_thread(void *arg)
+{
+    struct bench_thread *t = (struct bench_thread *)arg;
+    size_t size = t->cfg->command_size;
+    struct file filp = { 0 };
+    char *command;
+    unsigned long seq;
+    size_t len;
+
+    command = malloc(size);
+    if (command == NULL || aesd_open(t->inode, &filp) != 0) {
+        atomic_fetch_add(&result.errors, 1);
+        free(command);
+        return NULL;
+    }
+
+    for (seq = 0; !atomic_load(&stop); seq++) {
+        len = (size_t)snprintf(command, size, "W%u:%lu:", t->id, seq);
+        for (size_t i = len; i < size - 1; i++) {
+            command[i] = padding_char(t->id, seq, i - len);
+        }
+        command[size - 1] = '\n';
+
+        if (aesd_write(&filp, command, size, &filp.f_pos) != (ssize_t)size) {
+            atomic_fetch_add(&result.errors, 1);
+            break;
+        }
+        atomic_fetch_add(&result.writes, 1);
+        atomic_fetch_add(&result.write_bytes, size);
+    }
+    aesd_release(t->inode, &filp);
+    free(command);
+    return NULL;
+}
+
+/*
+ * Checks the commands in one read of the buffer: each one has to be command_size bytes long,
+ * and come after the previous command of its writer.
+ *
+ * Returns:
+ *   The number of corrupt or out of order commands
+ */
+static unsigned long check_buffer(const char *buf, size_t len, const struct bench_config *cfg)
+{
+    long last_seq[cfg->writers];
+    unsigned long corrupt = 0;
+    const char *line = buf;
+    const char *end = buf + len;
+    const char *newline;
+    unsigned int writer;
+    unsigned long seq;
+    int header;
+
+    for (unsigned int i = 0; i < cfg->writers; i++) {
+        last_seq[i] = -1;
+    }
+
+    /* Reads end on a command boundary, a trailing partial command is corrupt too */
+    while (line < end) {
+        newline = memchr(line, '\n', end - line);
+        if (newline == NULL || (size_t)(newline - line + 1) != cfg->command_size ||
+            sscanf(line, "W%u:%lu:%n", &writer, &seq, &header) != 2 || writer >= cfg->writers ||
+            (long)seq <= last_seq[writer]) {
+            return corrupt + 1;
+        }
+        for (const char *p = line + header; p < newline; p++) {
+            if (*p != padding_char(writer, seq, p - line - header)) {
+                corrupt++;
+                break;
+            }
+        }
+        last_seq[writer] = (long)seq;
+        line = newline + 1;
+    }
+    return corrupt;
+}
+
+static void *reader_thread(void *arg)
+{
+    struct bench_thread *t = (struct bench_thread *)arg;
+    struct file filp = { 0 };
+    size_t cap;
+    char *buf;
+    loff_t pos;
+    ssize_t n;
+
+    /* Room for a full buffer, so every read returns whole commands */
+    cap = (size_t)t->cfg->depth * t->cfg->command_size;
+    buf = malloc(cap);
+    if (buf == NULL || aesd_open(t->inode, &filp) != 0) {
+        atomic_fetch_add(&result.errors, 1);
+        free(buf);
+        return NULL;
+    }
+
+    while (!atomic_load(&stop)) {
+        pos = 0;
+        n = aesd_read(&filp, buf, cap, &pos);
+        if (n < 0) {
+            atomic_fetch_add(&result.errors, 1);
+            break;
+        }
+        atomic_fetch_add(&result.corrupt, check_buffer(buf, (size_t)n, t->cfg));
+        atomic_fetch_add(&result.reads, 1);
+        atomic_fetch_add(&result.read_bytes, (unsigned long)n);
+    }
+    aesd_release(t->inode, &filp);
+    free(buf);
+    return NULL;
+}
+
+static void *seeker_thread(void *arg)
+{
+    struct bench_thread *t = (struct bench_thread *)arg;
+    struct aesd_seekto seekto = { 0 };
+    struct file filp = { 0 };
+    unsigned long i;
+    long ret;
+
+    if (aesd_open(t->inode, &filp) != 0) {
+        atomic_fetch_add(&result.errors, 1);
+        return NULL;
+    }
+
+    for (i = 0; !atomic_load(&stop); i++) {
+        if (aesd_llseek(&filp, 0, SEEK_END) < 0 || aesd_llseek(&filp, 0, SEEK_SET) != 0) {
+            atomic_fetch_add(&result.errors, 1);
+            break;
+        }
+        /* The command may not be written yet or be evicted meanwhile, so EINVAL is fine */
+        seekto.write_cmd = i % t->cfg->depth;
+        seekto.write_cmd_offset = 0;
+        ret = aesd_unlocked_ioctl(&filp, AESDCHAR_IOCSEEKTO, (unsigned long)&seekto);
+        if (ret != 0 && ret != -EINVAL) {
+            atomic_fetch_add(&result.errors, 1);
+            break;
+        }
+        atomic_fetch_add(&result.seeks, 3);
+    }
+    aesd_release(t->inode, &filp);
+    return NULL;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-r readers] [-w writers] [-s seekers] [-t seconds] [-d depth]\n"
+            "          [-b max_bytes] [-m mmap_size] [-c command_size]\n"
+            "  -r  Reader threads (default 4)\n"
+            "  -w  Writer threads (default 2)\n"
+            "  -s  Seeker threads (default 1)\n"
+            "  -t  Duration in seconds (default 5)\n"
+            "  -d  Commands kept by the buffer (default 10)\n"
+            "  -b  Bytes of memory the commands kept by the buffer may hold, 0 for no limit (default 0)\n"
+            "  -m  Bytes of the mmap data ring kept up to date, 0 for none (default 0)\n"
+            "  -c  Bytes per command, including the newline (default 64)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_config cfg = {
+        .readers = 4,
+        .writers = 2,
+        .seekers = 1,
+        .seconds = 5,
+        .depth = AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED,
+        .max_bytes = 0,
+        .mmap_size = 0,
+        .command_size = 64,
+    };
+    struct bench_thread *threads;
+    struct aesd_dev *dev;
+    struct inode inode;
+    unsigned int count;
+    unsigned int i;
+    uint64_t start;
+    double elapsed;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:w:s:t:d:b:m:c:")) != -1) {
+        switch (opt) {
+        case 'r':
+            cfg.readers = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            cfg.writers = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            cfg.seekers = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            cfg.seconds = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            cfg.depth = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            cfg.max_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            cfg.mmap_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            cfg.command_size = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (cfg.writers == 0 || cfg.depth == 0 || cfg.command_size < COMMAND_HEADER_MAX + 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    dev = calloc(1, sizeof(*dev));
+    if (dev == NULL || aesd_command_cache_create() != 0) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    if (aesd_dev_init(dev, cfg.depth, cfg.max_bytes, cfg.mmap_size) != 0) {
+        fprintf(stderr, "Failed to set up a device keeping %u commands\n", cfg.depth);
+        return EXIT_FAILURE;
+    }
+    inode.i_cdev = &dev->cdev;
+
+    count = cfg.writers + cfg.readers + cfg.seekers;
+    threads = calloc(count, sizeof(*threads));
+    if (threads == NULL) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    start = now_ns();
+    for (i = 0; i < count; i++) {
+        void *(*fn)(void *) = i < cfg.writers ? writer_thread :
+                              i < cfg.writers + cfg.readers ? reader_thread : seeker_thread;
+        threads[i].id = i < cfg.writers ? i : i - cfg.writers;
+        threads[i].cfg = &cfg;
+        threads[i].inode = &inode;
+        if (pthread_create(&threads[i].thread_id, NULL, fn, &threads[i]) != 0) {
+            perror("pthread_create");
+            atomic_store(&stop, 1);
+            count = i;
+            break;
+        }
+    }
+
+    sleep(cfg.seconds);
+    atomic_store(&stop, 1);
+    for (i = 0; i < count; i++) {
+        pthread_join(threads[i].thread_id, NULL);
+    }
+    elapsed = (double)(now_ns() - start) / NSEC_PER_SEC;
+    free(threads);
+
+    /* Let the frees deferred for readers run before the device goes */
+    srcu_barrier(&aesd_srcu);
+    aesd_dev_free(dev);
+    free(dev);
+    aesd_command_cache_destroy();
+
+    printf("{\"seconds\": %.3f, \"readers\": %u, \"writers\": %u, \"seekers\": %u, \"depth\": %u, "
+           "\"command_size\": %zu, \"writes_per_sec\": %.1f, \"write_mb_per_sec\": %.1f, "
+           "\"reads_per_sec\": %.1f, \"read_mb_per_sec\": %.1f, \"seeks_per_sec\": %.1f, "
+           "\"corrupt\": %lu, \"errors\": %lu}\n",
+           elapsed, cfg.readers, cfg.writers, cfg.seekers, cfg.depth, cfg.command_size,
+           atomic_load(&result.writes) / elapsed, atomic_load(&result.write_bytes) / elapsed / 1e6,
+           atomic_load(&result.reads) / elapsed, atomic_load(&result.read_bytes) / elapsed / 1e6,
+           atomic_load(&result.seeks) / elapsed, atomic_load(&result.corrupt),
+           atomic_load(&result.errors));
+
+    return (atomic_load(&result.corrupt) || atomic_load(&result.errors)) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
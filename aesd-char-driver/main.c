@@ -17,276 +17,256 @@
 #include <linux/types.h>
 #include <linux/cdev.h>
 #include <linux/fs.h> // file_operations
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
+#include <linux/seqlock.h>
+#include <linux/srcu.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/uio.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
+#include <linux/highmem.h>
+#include <linux/pagemap.h>
 #include "aesdchar.h"
 #include "aesd_ioctl.h"
+#include "aesd-command.h"
 int aesd_major =   0; // use dynamic major
 int aesd_minor =   0;
 
+/* Number of commands kept by the device, which AESDCHAR_IOCSETDEPTH can change at runtime */
+static unsigned int aesd_depth = AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+module_param_named(depth, aesd_depth, uint, S_IRUGO);
+MODULE_PARM_DESC(depth, "Number of write commands kept in the circular buffer (default 10)");
+
+/* Bytes of memory the commands kept by the device may hold, which AESDCHAR_IOCSETMAXSIZE can change at runtime */
+static unsigned long aesd_max_bytes;
+module_param_named(max_bytes, aesd_max_bytes, ulong, S_IRUGO);
+MODULE_PARM_DESC(max_bytes, "Bytes of memory the write commands kept in the circular buffer may hold, 0 for no limit (default 0)");
+
+/*
+ * Size of the data ring which mmap exposes, rounded up to a power of two of whole pages. Off unless
+ * asked for, since the ring is a second copy of every command the writers have to keep up to date.
+ */
+static unsigned int aesd_mmap_size;
+module_param_named(mmap_size, aesd_mmap_size, uint, S_IRUGO);
+MODULE_PARM_DESC(mmap_size, "Bytes of command data readable through mmap, 0 to disable mmap (default 0)");
+
+/* Number of independent devices, each with its own buffer and lock */
+static unsigned int aesd_nr_devs = 1;
+module_param_named(devices, aesd_nr_devs, uint, S_IRUGO);
+MODULE_PARM_DESC(devices, "Number of aesdchar devices, /dev/aesdchar0 to /dev/aesdcharN-1 (default 1)");
+
 MODULE_AUTHOR("abhirathkoushik-cub");
 MODULE_LICENSE("Dual BSD/GPL");
 
-struct aesd_dev aesd_device;
-
-int aesd_open(struct inode *inode, struct file *filp)
-{
-    PDEBUG("open");
-    struct aesd_dev *dev;
-    dev = container_of(inode->i_cdev, struct aesd_dev, cdev);
-    filp->private_data = dev;
-    filp->f_pos = 0;
-    return 0;
-}
+/* Array of the aesd_nr_devs devices, one per minor */
+struct aesd_dev *aesd_devices;
 
-int aesd_release(struct inode *inode, struct file *filp)
-{
-    PDEBUG("release");
-    filp->private_data = NULL;
-    return 0;
-}
+/* State of a splice into an aesd file, shared by the calls of aesd_splice_actor() */
+struct aesd_splice_state {
+    struct aesd_file *file;
+    struct aesd_write_batch batch;
+};
 
-ssize_t aesd_read(struct file *filp, char __user *buf, size_t count,
-                loff_t *f_pos)
+/**
+ * Appends the bytes of one pipe buffer to the working command of the file spliced to, committing
+ * every command they complete. With SPLICE_F_MOVE, pages only the pipe holds are stolen and kept
+ * by reference, the others are copied once.
+ */
+static int aesd_splice_actor(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
+                struct splice_desc *sd)
 {
+    struct aesd_splice_state *state = sd->u.data;
+    struct aesd_file *file = state->file;
+    struct bio_vec bvec;
+    struct iov_iter from;
+    size_t done = 0;
     ssize_t retval = 0;
-    size_t entry_offset = 0;
-    struct aesd_buffer_entry *entry;
-    size_t bytes_read = 0;
-    struct aesd_dev *dev = filp->private_data;
-
-    PDEBUG("read %zu bytes with offset %lld",count,*f_pos);
-    
-    /* Lock device to protect our data */
-    if (mutex_lock_interruptible(&dev->lock))
-        return -ERESTARTSYS;
-    
-    entry = aesd_circular_buffer_find_entry_offset_for_fpos(&dev->circ_buf, *f_pos, &entry_offset);
-    if (!entry || entry->buffptr == NULL) 
-    {
-        retval = 0;
-        goto mutex_unlock;
+    bool steal;
+    bool complete;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    steal = (sd->flags & SPLICE_F_MOVE) && !PageHighMem(buf->page) && pipe_buf_try_steal(pipe, buf);
+#else
+    steal = (sd->flags & SPLICE_F_MOVE) && !PageHighMem(buf->page) && pipe_buf_steal(pipe, buf) == 0;
+#endif
+    if (steal) {
+        /* The page comes back locked, and the pipe still drops its own reference */
+        unlock_page(buf->page);
+    } else {
+        bvec.bv_page = buf->page;
+        bvec.bv_offset = buf->offset;
+        bvec.bv_len = sd->len;
+        iov_iter_bvec(&from, ITER_SOURCE, &bvec, 1, sd->len);
     }
-    
-    size_t available = entry->size - entry_offset;
-    if (available > count)
-        available = count;
-    
-
-    size_t not_copied = copy_to_user(buf, entry->buffptr + entry_offset, available);
 
-    if (not_copied)
+    while (done < sd->len)
     {
-        retval = -EFAULT;
-        goto mutex_unlock;
+        if (steal)
+            retval = aesd_command_append_page(&file->working_cmd, buf->page, buf->offset + done,
+                                              sd->len - done, &complete);
+        else
+            retval = aesd_command_append(&file->working_cmd, &from, &complete);
+        if (retval <= 0)
+            break;
+        done += retval;
+        if (complete)
+            aesd_batch_add(file, &state->batch);
     }
 
-    *f_pos += available;
-    retval  = available;
-
-    mutex_unlock:
-        mutex_unlock(&dev->lock);
-        return retval;
+    return done ? done : retval;
 }
 
-ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos)
+ssize_t aesd_splice_write(struct pipe_inode_info *pipe, struct file *out, loff_t *ppos,
+                size_t len, unsigned int flags)
 {
-    struct aesd_dev *dev = filp->private_data;
-    ssize_t retval = -ENOMEM;
-    char *kern_buf;
-    PDEBUG("write %zu bytes with offset %lld",count,*f_pos);
-
-    /* Allocate kernel memory for the incoming data */
-    kern_buf = (char *)kmalloc(count, GFP_KERNEL);
-    if(kern_buf == NULL) {
-        retval = -ENOMEM;
-        goto out;
-    }
-
-    size_t bytes_not_copied = copy_from_user(kern_buf, buf, count);
-    if (bytes_not_copied) 
-    {
-        kfree(kern_buf);
-        retval = -EFAULT;
-        goto out;
-    }
-
-    /* Searching for new line */
-    char *new_line_pos = memchr(kern_buf, '\n', count);
-    size_t num_copy = count;
-    if (new_line_pos != NULL)
-    {
-        num_copy = new_line_pos - kern_buf + 1;
-    }
-    
-    if(mutex_lock_interruptible(&dev->lock)) {
-        retval = -ERESTARTSYS;
-        kfree(kern_buf);
-        goto out;
-    }
-    
-    /* Append the new data to the working entry */
-    char *tmp = (char *)krealloc(dev->working_entry.buffptr, dev->working_entry.size + num_copy, GFP_KERNEL);
-    if (tmp == NULL) {
-        kfree(dev->working_entry.buffptr);
-        retval = -ENOMEM;
-        goto out;
-    }
-    dev->working_entry.buffptr = tmp;
-    memcpy(dev->working_entry.buffptr + dev->working_entry.size, kern_buf, num_copy); 
-    dev->working_entry.size += num_copy;
-    retval = num_copy;
+    struct aesd_splice_state state = { .file = out->private_data };
+    struct splice_desc sd = {
+        .total_len = len,
+        .flags = flags,
+        .pos = *ppos,
+        .u.data = &state,
+    };
+    ssize_t retval;
+    PDEBUG("splice_write %zu bytes", len);
+
+    retval = aesd_write_begin(state.file, &state.batch);
+    if (retval)
+        return retval;
 
-    /* Process newline if encountered */
-    if (new_line_pos != NULL)
-    {
-        char *temp_ptr = aesd_circular_buffer_add_entry(&dev->circ_buf, &dev->working_entry);
-        if (temp_ptr != NULL)
-        {
-            kfree(temp_ptr);
-        }
-        // Clear the buffer entry 
-        dev->working_entry.buffptr = NULL;
-        dev->working_entry.size = 0;
-    }
+    pipe_lock(pipe);
+    retval = __splice_from_pipe(pipe, &sd, aesd_splice_actor);
+    pipe_unlock(pipe);
 
-    out:
-        mutex_unlock(&dev->lock);
-        return retval;
+    aesd_write_end(state.file, &state.batch);
+    return retval;
 }
 
-loff_t aesd_llseek(struct file *filp, loff_t offset, int whence)
+/**
+ * Reports the file readable once a read at its position would return data, or would not have to
+ * wait for it with AESDCHAR_IOCSETBLOCKING, and always writable
+ */
+__poll_t aesd_poll(struct file *filp, poll_table *wait)
 {
-    struct aesd_dev *dev = filp->private_data;
-    loff_t newpos;
-    loff_t total_size = 0;
-    int i = 0;
-    struct aesd_buffer_entry *entry;
-
-    /* Lock the device to safely access the circular buffer */
-    if (mutex_lock_interruptible(&dev->lock))
-        return -ERESTARTSYS;
-
-    /* Sum up the sizes of all valid entries in the circular buffer */
-    AESD_CIRCULAR_BUFFER_FOREACH(entry, &dev->circ_buf, i) {
-        if (entry->buffptr)
-            total_size += entry->size;
-    }
+    struct aesd_file *file = filp->private_data;
+    __poll_t mask = EPOLLOUT | EPOLLWRNORM;
 
-    switch (whence) {
-    case SEEK_SET:
-        newpos = offset;
-        break;
-    case SEEK_CUR:
-        newpos = filp->f_pos + offset;
-        break;
-    case SEEK_END:
-        newpos = total_size + offset;
-        break;
-    default:
-        mutex_unlock(&dev->lock);
-        return -EINVAL;
-    }
-
-    if (newpos < 0) {
-        mutex_unlock(&dev->lock);
-        return -EINVAL;
-    }
-
-    filp->f_pos = newpos;
-    mutex_unlock(&dev->lock);
-    return newpos;
+    poll_wait(filp, &file->dev->wq, wait);
+    if (aesd_file_readable(filp, filp->f_pos))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    return mask;
 }
 
-long aesd_unlocked_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+/**
+ * Maps the header page and data ring of the device read-only, see struct aesd_mmap_header.
+ * The pages stay mapped after the file is closed, and the module stays loaded as long as they do.
+ */
+int aesd_mmap(struct file *filp, struct vm_area_struct *vma)
 {
-    struct aesd_dev *dev = filp->private_data;
-    long ret = 0;
-    struct aesd_seekto seekto;
-    struct aesd_buffer_entry *entry = NULL;
-    int command_index = 0;
-    int trav = dev->circ_buf.out_offs;
-    int byte_count = 0;
-
-    if (cmd == AESDCHAR_IOCSEEKTO) {
-        if (copy_from_user(&seekto, (struct aesd_seekto*) arg, sizeof(struct aesd_seekto)))
-            return -EFAULT;
-
-        command_index = seekto.write_cmd;
-        command_index = (command_index + dev->circ_buf.out_offs) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-        if ((command_index > AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED) || (seekto.write_cmd_offset > dev->circ_buf.entry[command_index].size))
-        {
-            ret = -EINVAL;
-            goto unlock;
-        }
-
-        /* Lock the device while processing the circular buffer */
-        if (mutex_lock_interruptible(&dev->lock))
-        return -ERESTARTSYS;
-
-        while(trav != command_index)
-        {
-            byte_count += dev->circ_buf.entry[trav].size;
-            trav = (trav + 1) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-        }
-
-        /* Update the file position with the computed offset */
-        filp->f_pos = byte_count + seekto.write_cmd_offset;
-        mutex_unlock(&dev->lock);
-    }
-    unlock:
-        return ret;
+    struct aesd_dev *dev = ((struct aesd_file *)filp->private_data)->dev;
+
+    if (dev->mmap_header == NULL)
+        return -ENODEV;
+    if (vma->vm_flags & VM_WRITE)
+        return -EACCES;
+
+    /* Don't let mprotect() make the mapping writable later */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+    return remap_vmalloc_range(vma, dev->mmap_header, vma->vm_pgoff);
 }
 
-
 struct file_operations aesd_fops = {
     .owner =    THIS_MODULE,
     .read =     aesd_read,
+    .read_iter = aesd_read_iter,
     .write =    aesd_write,
+    .write_iter = aesd_write_iter,
+    .splice_write = aesd_splice_write,
     .open =     aesd_open,
     .release =  aesd_release,
     .llseek  =  aesd_llseek,  
     .unlocked_ioctl = aesd_unlocked_ioctl,
+    .mmap =     aesd_mmap,
+    .poll =     aesd_poll,
 };
 
-static int aesd_setup_cdev(struct aesd_dev *dev)
+static int aesd_setup_cdev(struct aesd_dev *dev, unsigned int index)
 {
-    int err, devno = MKDEV(aesd_major, aesd_minor);
+    int err, devno = MKDEV(aesd_major, aesd_minor + index);
 
     cdev_init(&dev->cdev, &aesd_fops);
     dev->cdev.owner = THIS_MODULE;
     dev->cdev.ops = &aesd_fops;
     err = cdev_add (&dev->cdev, devno, 1);
     if (err) {
-        printk(KERN_ERR "Error %d adding aesd cdev", err);
+        printk(KERN_ERR "Error %d adding aesd cdev %u", err, index);
     }
     return err;
 }
 
-
-
 int aesd_init_module(void)
 {
     dev_t dev = 0;
+    unsigned int ready;
+    unsigned int i;
     int result;
-    result = alloc_chrdev_region(&dev, aesd_minor, 1,
+
+    if (aesd_nr_devs == 0 || aesd_nr_devs > AESDCHAR_MAX_DEVICES) {
+        printk(KERN_ERR "Can't create %u aesdchar devices\n", aesd_nr_devs);
+        return -EINVAL;
+    }
+    result = alloc_chrdev_region(&dev, aesd_minor, aesd_nr_devs,
             "aesdchar");
     aesd_major = MAJOR(dev);
     if (result < 0) {
         printk(KERN_WARNING "Can't get major %d\n", aesd_major);
         return result;
     }
-    memset(&aesd_device,0,sizeof(struct aesd_dev));
 
-    mutex_init(&aesd_device.lock);
-    aesd_circular_buffer_init(&aesd_device.circ_buf);
+    aesd_devices = kcalloc(aesd_nr_devs, sizeof(struct aesd_dev), GFP_KERNEL);
+    if (aesd_devices == NULL) {
+        unregister_chrdev_region(dev, aesd_nr_devs);
+        return -ENOMEM;
+    }
 
-     /* Initialize working entry to an empty state */
-     aesd_device.working_entry.buffptr = NULL;
-     aesd_device.working_entry.size = 0;
+    result = aesd_command_cache_create();
+    if (result) {
+        kfree(aesd_devices);
+        unregister_chrdev_region(dev, aesd_nr_devs);
+        return result;
+    }
 
-    result = aesd_setup_cdev(&aesd_device);
+    for (i = 0; i < aesd_nr_devs; i++) {
+        result = aesd_dev_init(&aesd_devices[i], aesd_depth, aesd_max_bytes, aesd_mmap_size);
+        if (result)
+            break;
+        result = aesd_setup_cdev(&aesd_devices[i], i);
+        if (result) {
+            aesd_dev_free(&aesd_devices[i]);
+            break;
+        }
+    }
 
     if( result ) {
-        unregister_chrdev_region(dev, 1);
+        /* Undo the devices set up before the one which failed */
+        ready = i;
+        for (i = 0; i < ready; i++)
+            cdev_del(&aesd_devices[i].cdev);
+        srcu_barrier(&aesd_srcu);
+        for (i = 0; i < ready; i++)
+            aesd_dev_free(&aesd_devices[i]);
+        kfree(aesd_devices);
+        aesd_command_cache_destroy();
+        unregister_chrdev_region(dev, aesd_nr_devs);
     }
     return result;
 
@@ -295,21 +275,20 @@ int aesd_init_module(void)
 void aesd_cleanup_module(void)
 {
     dev_t devno = MKDEV(aesd_major, aesd_minor);
+    unsigned int i;
 
-    cdev_del(&aesd_device.cdev);
+    for (i = 0; i < aesd_nr_devs; i++)
+        cdev_del(&aesd_devices[i].cdev);
 
-    int i = 0;
-    struct aesd_buffer_entry *entry;
-    AESD_CIRCULAR_BUFFER_FOREACH(entry, &aesd_device.circ_buf, i) {
-        if (entry->buffptr)
-            kfree((void*)entry->buffptr);
-    }
+    /* Let the frees deferred for readers run */
+    srcu_barrier(&aesd_srcu);
 
-    /* Free any data remaining in the working entry */
-    if (aesd_device.working_entry.buffptr)
-        kfree(aesd_device.working_entry.buffptr);
+    for (i = 0; i < aesd_nr_devs; i++)
+        aesd_dev_free(&aesd_devices[i]);
+    kfree(aesd_devices);
+    aesd_command_cache_destroy();
 
-    unregister_chrdev_region(devno, 1);
+    unregister_chrdev_region(devno, aesd_nr_devs);
 }
 
 module_init(aesd_init_module);
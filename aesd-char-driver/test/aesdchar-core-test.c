@@ -0,0 +1,196 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    aesdchar-core-test.c
+ * @brief   This file implements a test of writes carrying many commands at once, run against
+ *          the aesdchar driver core built in userspace.
+ *
+ * Each case writes one large buffer of newline separated commands with a single aesd_write(),
+ * then checks that every command was committed on its own with the right bytes, that the
+ * trailing partial command was kept for the next write, and that the memory the commands hold,
+ * as counted by aesd_command_footprint(), stays close to their bytes. Short commands can't take
+ * less than one slab object each, so the bound is twice the bytes plus one slab object per command.
+ *
+ * The exit status is non-zero if any case failed.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../userspace/kernel-shim.h"
+#include "../aesdchar.h"
+
+#define WRITE_SIZE (1 << 20)
+#define PARTIAL_MIN 100             // Bytes at least left after the last newline of each write
+
+/* Command lengths of a case, including the newline, cycled through until the write is full */
+struct test_case {
+    const char *name;
+    const size_t *lengths;
+    size_t nlengths;
+};
+
+static const size_t short_lengths[] = { 16 };
+static const size_t mixed_lengths[] = { 1, 2, 40, 191, 192, 193, 700, 769, 1000, 5000, 16, 70000, 3 };
+
+static const struct test_case cases[] = {
+    { "short", short_lengths, sizeof(short_lengths) / sizeof(short_lengths[0]) },
+    { "mixed", mixed_lengths, sizeof(mixed_lengths) / sizeof(mixed_lengths[0]) },
+};
+
+/*
+ * Fills the WRITE_SIZE bytes of @param buf with commands of the lengths of @param tc, followed by
+ * a partial command of at least PARTIAL_MIN bytes without a newline, recording the length of each
+ * command in @param lengths.
+ *
+ * Returns:
+ *   The number of complete commands
+ */
+static unsigned int fill_commands(const struct test_case *tc, char *buf, size_t *lengths)
+{
+    unsigned int count = 0;
+    size_t pos = 0;
+    size_t len;
+    size_t i;
+
+    for (;;) {
+        len = tc->lengths[count % tc->nlengths];
+        if (pos + len > WRITE_SIZE - PARTIAL_MIN) {
+            break;
+        }
+        for (i = 0; i < len - 1; i++) {
+            buf[pos + i] = 'a' + (count + i) % 26;
+        }
+        buf[pos + len - 1] = '\n';
+        lengths[count++] = len;
+        pos += len;
+    }
+    memset(buf + pos, 'p', WRITE_SIZE - pos);
+    return count;
+}
+
+/*
+ * Runs one case on a fresh device.
+ *
+ * Returns:
+ *   0 if the case passed, -1 otherwise
+ */
+static int run_case(const struct test_case *tc, char *buf, char *out, size_t *lengths)
+{
+    struct aesd_dev *dev;
+    struct aesd_buffer_entry *entry;
+    struct inode inode;
+    struct file filp = { 0 };
+    unsigned int count;
+    unsigned int i;
+    size_t payload = 0;
+    size_t footprint = 0;
+    size_t bound;
+    ssize_t n;
+    loff_t pos = 0;
+    int result = -1;
+
+    count = fill_commands(tc, buf, lengths);
+    for (i = 0; i < count; i++) {
+        payload += lengths[i];
+    }
+
+    dev = calloc(1, sizeof(*dev));
+    if (dev == NULL || aesd_dev_init(dev, AESDCHAR_MAX_DEPTH, 0, 0) != 0) {
+        fprintf(stderr, "%s: failed to set up a device\n", tc->name);
+        free(dev);
+        return -1;
+    }
+    inode.i_cdev = &dev->cdev;
+    if (aesd_open(&inode, &filp) != 0) {
+        fprintf(stderr, "%s: failed to open the device\n", tc->name);
+        goto out;
+    }
+
+    n = aesd_write(&filp, buf, WRITE_SIZE, &filp.f_pos);
+    if (n != WRITE_SIZE) {
+        fprintf(stderr, "%s: write returned %zd, expected %d\n", tc->name, n, WRITE_SIZE);
+        goto out_release;
+    }
+    if (dev->circ_buf.count != count || dev->circ_buf.total_size != payload) {
+        fprintf(stderr, "%s: %u commands of %zu bytes committed, expected %u of %zu\n", tc->name,
+                dev->circ_buf.count, dev->circ_buf.total_size, count, payload);
+        goto out_release;
+    }
+    for (i = 0; i < count; i++) {
+        entry = &dev->circ_buf.entry[(dev->circ_buf.out_offs + i) & dev->circ_buf.mask];
+        if (entry->size != lengths[i]) {
+            fprintf(stderr, "%s: command %u has %zu bytes, expected %zu\n", tc->name, i,
+                    entry->size, lengths[i]);
+            goto out_release;
+        }
+        footprint += aesd_command_footprint(entry->buffptr);
+    }
+    if (filp.private_data == NULL ||
+        ((struct aesd_file *)filp.private_data)->working_cmd.size != WRITE_SIZE - payload) {
+        fprintf(stderr, "%s: the trailing partial command was not kept\n", tc->name);
+        goto out_release;
+    }
+
+    n = aesd_read(&filp, out, WRITE_SIZE, &pos);
+    if (n != (ssize_t)payload || memcmp(out, buf, payload) != 0) {
+        fprintf(stderr, "%s: read back %zd bytes which don't match the %zu written\n", tc->name, n,
+                payload);
+        goto out_release;
+    }
+
+    bound = 2 * payload + (size_t)count * AESD_COMMAND_SLAB_SIZE;
+    if (footprint != dev->mem_size || footprint > bound) {
+        fprintf(stderr, "%s: commands hold %zu bytes (device counts %zu) for %zu bytes, bound %zu\n",
+                tc->name, footprint, dev->mem_size, payload, bound);
+        goto out_release;
+    }
+
+    printf("%s: %u commands, %zu bytes held for %zu bytes\n", tc->name, count, footprint, payload);
+    result = 0;
+
+out_release:
+    aesd_release(&inode, &filp);
+out:
+    /* Let the frees deferred for readers run before the device goes */
+    srcu_barrier(&aesd_srcu);
+    aesd_dev_free(dev);
+    free(dev);
+    return result;
+}
+
+int main(void)
+{
+    char *buf = malloc(WRITE_SIZE);
+    char *out = malloc(WRITE_SIZE);
+    size_t *lengths = calloc(WRITE_SIZE, sizeof(*lengths));
+    int failed = 0;
+    size_t i;
+
+    if (buf == NULL || out == NULL || lengths == NULL || aesd_command_cache_create() != 0) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (run_case(&cases[i], buf, out, lengths) != 0) {
+            failed = 1;
+        }
+    }
+    aesd_command_cache_destroy();
+    free(lengths);
+    free(out);
+    free(buf);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,427 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    aesdchar-stress.c
+ * @brief   This file implements a stress test for the aesdchar driver, hammering a loaded
+ *          device with concurrent readers and writers.
+ *
+ * Every writer thread writes whole commands of the form "S<writer>:<seq>:<padding>\n" with
+ * one write() each, where the padding is derived from writer and seq. Every reader thread
+ * reads the whole buffer with a single pread() and checks that each command in it starting
+ * with 'S' is intact and that the commands of each writer appear in order. Readers also seek
+ * with AESDCHAR_IOCSEEKTO and SEEK_END, and with -z one more thread keeps resizing the buffer
+ * with AESDCHAR_IOCSETDEPTH, restoring the original depth at the end. With -m readers take
+ * their copy of the buffer from the read-only mapping of the device instead of pread(), which
+ * the module only offers when loaded with a non-zero mmap_size.
+ *
+ * The exit status is non-zero if any command read back was corrupt or out of order, or any
+ * call failed.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "../aesd_ioctl.h"
+
+#define DEFAULT_DEVICE "/dev/aesdchar"
+#define COMMAND_MAX 512
+#define READ_BUFFER_INITIAL (1 << 20)
+
+/* Stress settings shared by all threads */
+struct stress_config {
+    const char *device;
+    unsigned int readers;
+    unsigned int writers;
+    unsigned int seconds;
+    int resize;
+    int mmap;
+};
+
+/* Counters of all threads */
+struct stress_result {
+    atomic_ulong writes;
+    atomic_ulong reads;
+    atomic_ulong map_retries;
+    atomic_ulong commands_checked;
+    atomic_ulong seeks;
+    atomic_ulong resizes;
+    atomic_ulong corrupt;
+    atomic_ulong errors;
+};
+
+/* Structure to hold the state of one thread */
+struct stress_thread {
+    pthread_t thread_id;
+    unsigned int id;
+    const struct stress_config *cfg;
+};
+
+static struct stress_result result;
+static atomic_int stop;
+
+/*
+ * Returns the padding character at position i of the command seq of writer.
+ */
+static char padding_char(unsigned int writer, unsigned long seq, size_t i)
+{
+    return 'a' + (writer * 7 + seq * 3 + i) % 26;
+}
+
+static void *writer_thread(void *arg)
+{
+    struct stress_thread *t = (struct stress_thread *)arg;
+    char command[COMMAND_MAX];
+    unsigned long seq;
+    size_t len;
+    size_t padding;
+    int fd;
+
+    fd = open(t->cfg->device, O_WRONLY);
+    if (fd < 0) {
+        perror("open");
+        atomic_fetch_add(&result.errors, 1);
+        return NULL;
+    }
+
+    for (seq = 0; !atomic_load(&stop); seq++) {
+        len = (size_t)snprintf(command, sizeof(command), "S%u:%lu:", t->id, seq);
+        padding = (seq * 37 + t->id) % (COMMAND_MAX - len - 1);
+        for (size_t i = 0; i < padding; i++) {
+            command[len + i] = padding_char(t->id, seq, i);
+        }
+        len += padding;
+        command[len++] = '\n';
+
+        /* The device commits a command per write, so it has to go out whole */
+        if (write(fd, command, len) != (ssize_t)len) {
+            perror("write");
+            atomic_fetch_add(&result.errors, 1);
+            break;
+        }
+        atomic_fetch_add(&result.writes, 1);
+    }
+    close(fd);
+    return NULL;
+}
+
+/*
+ * Checks the commands in one read of the buffer.
+ *
+ * Returns:
+ *   The number of corrupt or out of order commands
+ */
+static unsigned long check_buffer(const char *buf, size_t len, unsigned int writers)
+{
+    long last_seq[writers];
+    unsigned long corrupt = 0;
+    const char *line = buf;
+    const char *end = buf + len;
+    const char *newline;
+    unsigned int writer;
+    unsigned long seq;
+    int header;
+
+    for (unsigned int i = 0; i < writers; i++) {
+        last_seq[i] = -1;
+    }
+
+    while (line < end && (newline = memchr(line, '\n', end - line)) != NULL) {
+        /* Lines written by anyone else are skipped */
+        if (line[0] == 'S') {
+            if (sscanf(line, "S%u:%lu:%n", &writer, &seq, &header) != 2 || writer >= writers ||
+                (long)seq <= last_seq[writer]) {
+                corrupt++;
+            } else {
+                for (const char *p = line + header; p < newline; p++) {
+                    if (*p != padding_char(writer, seq, p - line - header)) {
+                        corrupt++;
+                        break;
+                    }
+                }
+                last_seq[writer] = (long)seq;
+            }
+            atomic_fetch_add(&result.commands_checked, 1);
+        }
+        line = newline + 1;
+    }
+    return corrupt;
+}
+
+/*
+ * Copies the commands in the buffer from the mapping of the device, following the protocol
+ * described with struct aesd_mmap_header.
+ *
+ * Returns:
+ *   The number of bytes copied, or -1 if the commands don't fit the data ring
+ */
+static ssize_t map_read(const char *map, char *buf, size_t cap)
+{
+    const struct aesd_mmap_header *header = (const struct aesd_mmap_header *)map;
+    const char *data = map + header->data_offset;
+    uint64_t mask = header->data_size - 1;
+    uint64_t start;
+    uint64_t total;
+    uint32_t seq;
+    size_t first;
+
+    for (;;) {
+        seq = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            atomic_fetch_add(&result.map_retries, 1);
+            continue;
+        }
+        total = header->total_size;
+        start = header->stream_end - total;
+        if (total > header->data_size || total > cap) {
+            return -1;
+        }
+        first = header->data_size - (start & mask);
+        if (first > total) {
+            first = total;
+        }
+        memcpy(buf, data + (start & mask), first);
+        memcpy(buf + first, data, total - first);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&header->seq, __ATOMIC_RELAXED) == seq) {
+            return (ssize_t)total;
+        }
+        atomic_fetch_add(&result.map_retries, 1);
+    }
+}
+
+static void *reader_thread(void *arg)
+{
+    struct stress_thread *t = (struct stress_thread *)arg;
+    struct aesd_seekto seekto = { 0 };
+    size_t cap = READ_BUFFER_INITIAL;
+    const struct aesd_mmap_header *header;
+    char *map = MAP_FAILED;
+    size_t map_len = 0;
+    char *buf;
+    ssize_t n;
+    int fd;
+
+    buf = malloc(cap);
+    fd = open(t->cfg->device, O_RDONLY);
+    if (buf == NULL || fd < 0) {
+        perror("open");
+        atomic_fetch_add(&result.errors, 1);
+        free(buf);
+        return NULL;
+    }
+    if (t->cfg->mmap) {
+        /* Map the header alone first to learn the size of the data ring */
+        header = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+        if (header != MAP_FAILED) {
+            map_len = header->data_offset + header->data_size;
+            munmap((void *)header, sysconf(_SC_PAGESIZE));
+            map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            atomic_fetch_add(&result.errors, 1);
+            close(fd);
+            free(buf);
+            return NULL;
+        }
+    }
+
+    while (!atomic_load(&stop)) {
+        /* One copy has to see a consistent run of commands */
+        n = -1;
+        if (map != MAP_FAILED) {
+            n = map_read(map, buf, cap);
+        }
+        if (n < 0) {
+            n = pread(fd, buf, cap, 0);
+        }
+        if (n < 0) {
+            perror("pread");
+            atomic_fetch_add(&result.errors, 1);
+            break;
+        }
+        if ((size_t)n == cap) {
+            /* Retry with a larger buffer, a partial buffer may end mid command */
+            char *bigger = realloc(buf, cap * 2);
+            if (bigger == NULL) {
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+            continue;
+        }
+        atomic_fetch_add(&result.corrupt, check_buffer(buf, (size_t)n, t->cfg->writers));
+        atomic_fetch_add(&result.reads, 1);
+
+        /* The command may be evicted meanwhile, so EINVAL is fine */
+        seekto.write_cmd = t->id;
+        seekto.write_cmd_offset = 1;
+        if (ioctl(fd, AESDCHAR_IOCSEEKTO, &seekto) < 0 && errno != EINVAL) {
+            perror("ioctl AESDCHAR_IOCSEEKTO");
+            atomic_fetch_add(&result.errors, 1);
+        }
+        if (lseek(fd, 0, SEEK_END) < 0) {
+            perror("lseek");
+            atomic_fetch_add(&result.errors, 1);
+        }
+        atomic_fetch_add(&result.seeks, 2);
+    }
+    if (map != MAP_FAILED) {
+        munmap(map, map_len);
+    }
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+static void *resize_thread(void *arg)
+{
+    struct stress_thread *t = (struct stress_thread *)arg;
+    static const uint32_t depths[] = { 1, 3, 10, 16, 100, 1000, 17, 64 };
+    uint32_t original;
+    unsigned int i;
+    int fd;
+
+    fd = open(t->cfg->device, O_RDONLY);
+    if (fd < 0 || ioctl(fd, AESDCHAR_IOCGETDEPTH, &original) < 0) {
+        perror("resize");
+        atomic_fetch_add(&result.errors, 1);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    for (i = 0; !atomic_load(&stop); i++) {
+        if (ioctl(fd, AESDCHAR_IOCSETDEPTH, &depths[i % (sizeof(depths) / sizeof(depths[0]))]) < 0) {
+            perror("ioctl AESDCHAR_IOCSETDEPTH");
+            atomic_fetch_add(&result.errors, 1);
+            break;
+        }
+        atomic_fetch_add(&result.resizes, 1);
+        usleep(1000);
+    }
+
+    ioctl(fd, AESDCHAR_IOCSETDEPTH, &original);
+    close(fd);
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-d device] [-r readers] [-w writers] [-t seconds] [-z] [-m]\n"
+            "  -d  Device to stress (default " DEFAULT_DEVICE ")\n"
+            "  -r  Reader threads (default 4)\n"
+            "  -w  Writer threads (default 2)\n"
+            "  -t  Duration in seconds (default 10)\n"
+            "  -z  Keep resizing the buffer with AESDCHAR_IOCSETDEPTH\n"
+            "  -m  Read the buffer through mmap, falling back to pread() when it doesn't fit. Needs\n"
+            "      the module loaded with mmap_size set\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    struct stress_config cfg = {
+        .device = DEFAULT_DEVICE,
+        .readers = 4,
+        .writers = 2,
+        .seconds = 10,
+        .resize = 0,
+        .mmap = 0,
+    };
+    struct stress_thread *threads;
+    unsigned int count;
+    unsigned int i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:r:w:t:zm")) != -1) {
+        switch (opt) {
+        case 'd':
+            cfg.device = optarg;
+            break;
+        case 'r':
+            cfg.readers = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            cfg.writers = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            cfg.seconds = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'z':
+            cfg.resize = 1;
+            break;
+        case 'm':
+            cfg.mmap = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (cfg.writers == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    count = cfg.readers + cfg.writers + (cfg.resize ? 1 : 0);
+    threads = calloc(count, sizeof(*threads));
+    if (threads == NULL) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < count; i++) {
+        void *(*fn)(void *) = i < cfg.writers ? writer_thread :
+                              i < cfg.writers + cfg.readers ? reader_thread : resize_thread;
+        threads[i].id = i < cfg.writers ? i : i - cfg.writers;
+        threads[i].cfg = &cfg;
+        if (pthread_create(&threads[i].thread_id, NULL, fn, &threads[i]) != 0) {
+            perror("pthread_create");
+            atomic_store(&stop, 1);
+            count = i;
+            break;
+        }
+    }
+
+    sleep(cfg.seconds);
+    atomic_store(&stop, 1);
+    for (i = 0; i < count; i++) {
+        pthread_join(threads[i].thread_id, NULL);
+    }
+    free(threads);
+
+    printf("{\"seconds\": %u, \"readers\": %u, \"writers\": %u, "
+           "\"writes_per_sec\": %.1f, \"reads_per_sec\": %.1f, \"commands_checked\": %lu, "
+           "\"seeks\": %lu, \"resizes\": %lu, \"map_retries\": %lu, \"corrupt\": %lu, \"errors\": %lu}\n",
+           cfg.seconds, cfg.readers, cfg.writers,
+           (double)atomic_load(&result.writes) / cfg.seconds,
+           (double)atomic_load(&result.reads) / cfg.seconds,
+           atomic_load(&result.commands_checked), atomic_load(&result.seeks),
+           atomic_load(&result.resizes), atomic_load(&result.map_retries), atomic_load(&result.corrupt),
+           atomic_load(&result.errors));
+
+    return (atomic_load(&result.corrupt) || atomic_load(&result.errors)) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,282 @@
+/**
+ * @file kernel-shim.c
+ * @brief Userspace implementations of the kernel interfaces declared in kernel-shim.h
+ *
+ * @author Abhirath Koushik
+ * @date 2026-10-16
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <stdlib.h>
+#include "kernel-shim.h"
+
+unsigned long roundup_pow_of_two(unsigned long n)
+{
+    unsigned long p = 1;
+
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+int get_order(unsigned long size)
+{
+    int order = 0;
+
+    size = (size - 1) >> PAGE_SHIFT;
+    while (size != 0) {
+        order++;
+        size >>= 1;
+    }
+    return order;
+}
+
+void *kmalloc(size_t size, gfp_t flags)
+{
+    return malloc(size);
+}
+
+void *kcalloc(size_t n, size_t size, gfp_t flags)
+{
+    return calloc(n, size);
+}
+
+void kfree(const void *ptr)
+{
+    free((void *)ptr);
+}
+
+/* Zeroed and page aligned, like the kernel's */
+void *vmalloc_user(unsigned long size)
+{
+    void *ptr = aligned_alloc(PAGE_SIZE, PAGE_ALIGN(size));
+
+    if (ptr != NULL)
+        memset(ptr, 0, PAGE_ALIGN(size));
+    return ptr;
+}
+
+void vfree(const void *ptr)
+{
+    free((void *)ptr);
+}
+
+unsigned long __get_free_pages(gfp_t flags, unsigned int order)
+{
+    return (unsigned long)aligned_alloc(PAGE_SIZE, PAGE_SIZE << order);
+}
+
+void free_pages(unsigned long addr, unsigned int order)
+{
+    free((void *)addr);
+}
+
+struct kmem_cache {
+    size_t size;
+};
+
+struct kmem_cache *kmem_cache_create(const char *name, unsigned int size, unsigned int align,
+            unsigned int flags, void (*ctor)(void *))
+{
+    struct kmem_cache *cache = malloc(sizeof(*cache));
+
+    if (cache != NULL)
+        cache->size = size;
+    return cache;
+}
+
+void kmem_cache_destroy(struct kmem_cache *cache)
+{
+    free(cache);
+}
+
+void *kmem_cache_alloc(struct kmem_cache *cache, gfp_t flags)
+{
+    return malloc(cache->size);
+}
+
+void kmem_cache_free(struct kmem_cache *cache, void *obj)
+{
+    free(obj);
+}
+
+/**
+ * Waits for every SRCU read side section of @param ssp running now to end. Flipping idx twice
+ * waits for a reader which read idx just before the first flip but counted itself only after it,
+ * too.
+ */
+void synchronize_srcu(struct srcu_struct *ssp)
+{
+    unsigned int old;
+    int i;
+
+    pthread_mutex_lock(&ssp->gp_lock);
+    for (i = 0; i < 2; i++) {
+        old = atomic_fetch_add(&ssp->idx, 1) & 1;
+        while (atomic_load(&ssp->readers[old]) != 0)
+            sched_yield();
+    }
+    pthread_mutex_unlock(&ssp->gp_lock);
+}
+
+/**
+ * Runs the callbacks of the list @param head, whose grace period is over
+ * @return the number of callbacks run
+ */
+static unsigned long srcu_run_callbacks(struct rcu_head *head)
+{
+    struct rcu_head *next;
+    unsigned long n;
+
+    for (n = 0; head != NULL; n++) {
+        next = head->next;
+        head->func(head);
+        head = next;
+    }
+    return n;
+}
+
+/**
+ * Runs the callbacks queued on the srcu_struct @param arg, one grace period for everything queued
+ * while the previous batch was waiting for its own
+ */
+static void *srcu_worker(void *arg)
+{
+    struct srcu_struct *ssp = arg;
+    struct rcu_head *head;
+    unsigned long n;
+
+    pthread_mutex_lock(&ssp->lock);
+    for (;;) {
+        while (ssp->pending == NULL)
+            pthread_cond_wait(&ssp->work, &ssp->lock);
+        head = ssp->pending;
+        ssp->pending = NULL;
+        pthread_mutex_unlock(&ssp->lock);
+
+        synchronize_srcu(ssp);
+        n = srcu_run_callbacks(head);
+
+        pthread_mutex_lock(&ssp->lock);
+        ssp->completed += n;
+        pthread_cond_broadcast(&ssp->done);
+    }
+    return NULL;
+}
+
+void call_srcu(struct srcu_struct *ssp, struct rcu_head *head, void (*func)(struct rcu_head *head))
+{
+    pthread_t thread;
+
+    head->func = func;
+    pthread_mutex_lock(&ssp->lock);
+    if (!ssp->worker && pthread_create(&thread, NULL, srcu_worker, ssp) == 0) {
+        pthread_detach(thread);
+        ssp->worker = true;
+    }
+    /* Without a worker the callbacks wait for srcu_barrier() */
+    head->next = ssp->pending;
+    ssp->pending = head;
+    ssp->queued++;
+    pthread_cond_signal(&ssp->work);
+    pthread_mutex_unlock(&ssp->lock);
+}
+
+/**
+ * Waits until every callback queued on @param ssp so far has run
+ */
+void srcu_barrier(struct srcu_struct *ssp)
+{
+    struct rcu_head *head;
+    unsigned long target;
+
+    pthread_mutex_lock(&ssp->lock);
+    if (!ssp->worker) {
+        head = ssp->pending;
+        ssp->pending = NULL;
+        pthread_mutex_unlock(&ssp->lock);
+        synchronize_srcu(ssp);
+        srcu_run_callbacks(head);
+        return;
+    }
+    target = ssp->queued;
+    while (ssp->completed < target)
+        pthread_cond_wait(&ssp->done, &ssp->lock);
+    pthread_mutex_unlock(&ssp->lock);
+}
+
+void iov_iter_init(struct iov_iter *i, unsigned int direction, const struct iovec *iov,
+            unsigned long nr_segs, size_t count)
+{
+    i->iov = iov;
+    i->nr_segs = nr_segs;
+    i->iov_offset = 0;
+    i->count = count;
+}
+
+void iov_iter_kvec(struct iov_iter *i, unsigned int direction, const struct kvec *kvec,
+            unsigned long nr_segs, size_t count)
+{
+    iov_iter_init(i, direction, (const struct iovec *)kvec, nr_segs, count);
+}
+
+/**
+ * Copies @param bytes between @param addr and the buffers of @param i, to them if @param to is
+ * set, advancing i
+ * @return the number of bytes copied, less than bytes once i is exhausted
+ */
+static size_t iov_iter_copy(char *addr, size_t bytes, struct iov_iter *i, bool to)
+{
+    size_t done = 0;
+    size_t n;
+    char *base;
+
+    while (done < bytes && i->count > 0) {
+        if (i->iov_offset == i->iov->iov_len) {
+            i->iov++;
+            i->nr_segs--;
+            i->iov_offset = 0;
+            continue;
+        }
+        n = min(bytes - done, i->iov->iov_len - i->iov_offset);
+        n = min(n, i->count);
+        base = (char *)i->iov->iov_base + i->iov_offset;
+        if (to)
+            memcpy(base, addr + done, n);
+        else
+            memcpy(addr + done, base, n);
+        i->iov_offset += n;
+        i->count -= n;
+        done += n;
+    }
+    return done;
+}
+
+size_t copy_from_iter(void *addr, size_t bytes, struct iov_iter *i)
+{
+    return iov_iter_copy(addr, bytes, i, false);
+}
+
+size_t copy_to_iter(const void *addr, size_t bytes, struct iov_iter *i)
+{
+    return iov_iter_copy((char *)addr, bytes, i, true);
+}
+
+void iov_iter_revert(struct iov_iter *i, size_t bytes)
+{
+    size_t n;
+
+    while (bytes > 0) {
+        if (i->iov_offset == 0) {
+            i->iov--;
+            i->nr_segs++;
+            i->iov_offset = i->iov->iov_len;
+            continue;
+        }
+        n = min(bytes, i->iov_offset);
+        i->iov_offset -= n;
+        i->count += n;
+        bytes -= n;
+    }
+}
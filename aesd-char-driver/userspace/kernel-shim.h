@@ -0,0 +1,290 @@
+/*
+ * kernel-shim.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Abhirath Koushik
+ *
+ *  @brief Userspace stand-ins for the kernel interfaces used by the driver core
+ *
+ *  aesd-core.c, aesd-command.c and aesd-circular-buffer.c include this header instead of the
+ *  kernel headers when built without __KERNEL__, so the read/write/seek/ioctl logic of the driver
+ *  can be benchmarked and fuzzed as a plain library. Mutexes and wait queues map to pthreads,
+ *  kmalloc and the page allocator to malloc, copy_*_user to memcpy, and SRCU to a small grace
+ *  period implementation in kernel-shim.c. A struct file and struct inode only carry what the
+ *  core uses, so a benchmark opens a device with a struct inode pointing at its cdev.
+ */
+
+#ifndef AESD_KERNEL_SHIM_H
+#define AESD_KERNEL_SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define __user
+
+/* Returned by interrupted system calls inside the kernel, never seen by user space */
+#define ERESTARTSYS 512
+
+#define KERN_ERR ""
+#define KERN_WARNING ""
+#define KERN_DEBUG ""
+#define printk(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#define min(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); _a < _b ? _a : _b; })
+#define max_t(type, a, b) ({ type _a = (a); type _b = (b); _a > _b ? _a : _b; })
+
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v) (*(volatile __typeof__(x) *)&(x) = (v))
+#define smp_wmb() atomic_thread_fence(memory_order_release)
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/*
+ * Memory
+ */
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+#define PAGE_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+typedef unsigned int gfp_t;
+#define GFP_KERNEL 0
+#define __GFP_NOWARN 0
+#define __GFP_NORETRY 0
+#define SLAB_HWCACHE_ALIGN 0
+
+extern unsigned long roundup_pow_of_two(unsigned long n);
+extern int get_order(unsigned long size);
+
+extern void *kmalloc(size_t size, gfp_t flags);
+extern void *kcalloc(size_t n, size_t size, gfp_t flags);
+extern void kfree(const void *ptr);
+extern void *vmalloc_user(unsigned long size);
+extern void vfree(const void *ptr);
+extern unsigned long __get_free_pages(gfp_t flags, unsigned int order);
+extern void free_pages(unsigned long addr, unsigned int order);
+
+struct kmem_cache;
+extern struct kmem_cache *kmem_cache_create(const char *name, unsigned int size, unsigned int align,
+            unsigned int flags, void (*ctor)(void *));
+extern void kmem_cache_destroy(struct kmem_cache *cache);
+extern void *kmem_cache_alloc(struct kmem_cache *cache, gfp_t flags);
+extern void kmem_cache_free(struct kmem_cache *cache, void *obj);
+
+/* Userspace builds never splice, so no command references a page it didn't allocate */
+struct page;
+#define page_address(page) ((void *)(page))
+#define get_page(page) do { } while (0)
+#define put_page(page) do { } while (0)
+
+static inline unsigned long copy_from_user(void *to, const void *from, unsigned long n)
+{
+    memcpy(to, from, n);
+    return 0;
+}
+
+static inline unsigned long copy_to_user(void *to, const void *from, unsigned long n)
+{
+    memcpy(to, from, n);
+    return 0;
+}
+
+/*
+ * Locking
+ */
+struct mutex {
+    pthread_mutex_t m;
+};
+
+#define mutex_init(lock) pthread_mutex_init(&(lock)->m, NULL)
+#define mutex_destroy(lock) pthread_mutex_destroy(&(lock)->m)
+#define mutex_lock(lock) pthread_mutex_lock(&(lock)->m)
+#define mutex_lock_interruptible(lock) (pthread_mutex_lock(&(lock)->m), 0)
+#define mutex_unlock(lock) pthread_mutex_unlock(&(lock)->m)
+
+typedef struct {
+    pthread_spinlock_t s;
+} spinlock_t;
+
+#define spin_lock_init(lock) pthread_spin_init(&(lock)->s, PTHREAD_PROCESS_PRIVATE)
+#define spin_lock(lock) pthread_spin_lock(&(lock)->s)
+#define spin_unlock(lock) pthread_spin_unlock(&(lock)->s)
+
+/* Odd while a writer is between write_seqcount_begin() and write_seqcount_end() */
+typedef struct {
+    atomic_uint sequence;
+} seqcount_mutex_t;
+
+#define seqcount_mutex_init(s, lock) atomic_init(&(s)->sequence, 0)
+
+static inline unsigned int read_seqcount_begin(seqcount_mutex_t *s)
+{
+    unsigned int seq;
+
+    while ((seq = atomic_load_explicit(&s->sequence, memory_order_acquire)) & 1)
+        sched_yield();
+    return seq;
+}
+
+static inline int read_seqcount_retry(seqcount_mutex_t *s, unsigned int start)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&s->sequence, memory_order_relaxed) != start;
+}
+
+static inline void write_seqcount_begin(seqcount_mutex_t *s)
+{
+    atomic_store_explicit(&s->sequence, atomic_load_explicit(&s->sequence, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void write_seqcount_end(seqcount_mutex_t *s)
+{
+    atomic_store_explicit(&s->sequence, atomic_load_explicit(&s->sequence, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+/*
+ * Readers count themselves in one of two counters, and a grace period waits for both to drain in
+ * turn, so readers starting meanwhile never hold it up. As in the kernel, call_srcu() never waits:
+ * a worker thread started by its first call runs the grace periods and callbacks.
+ */
+struct rcu_head {
+    struct rcu_head *next;
+    void (*func)(struct rcu_head *head);
+};
+
+struct srcu_struct {
+    atomic_ulong readers[2];
+    atomic_uint idx;
+    pthread_mutex_t gp_lock;    /* Serializes grace periods */
+    pthread_mutex_t lock;       /* Guards the fields below */
+    pthread_cond_t work;        /* Signaled when callbacks are queued */
+    pthread_cond_t done;        /* Signaled when callbacks have run */
+    struct rcu_head *pending;
+    unsigned long queued;       /* Callbacks queued so far */
+    unsigned long completed;    /* Callbacks run so far */
+    bool worker;
+};
+
+#define DEFINE_SRCU(name) struct srcu_struct name = { \
+        .gp_lock = PTHREAD_MUTEX_INITIALIZER, \
+        .lock = PTHREAD_MUTEX_INITIALIZER, \
+        .work = PTHREAD_COND_INITIALIZER, \
+        .done = PTHREAD_COND_INITIALIZER, \
+    }
+#define DEFINE_STATIC_SRCU(name) static DEFINE_SRCU(name)
+
+static inline int srcu_read_lock(struct srcu_struct *ssp)
+{
+    int idx = atomic_load(&ssp->idx) & 1;
+
+    atomic_fetch_add(&ssp->readers[idx], 1);
+    return idx;
+}
+
+static inline void srcu_read_unlock(struct srcu_struct *ssp, int idx)
+{
+    atomic_fetch_sub(&ssp->readers[idx], 1);
+}
+
+extern void synchronize_srcu(struct srcu_struct *ssp);
+extern void call_srcu(struct srcu_struct *ssp, struct rcu_head *head, void (*func)(struct rcu_head *head));
+extern void srcu_barrier(struct srcu_struct *ssp);
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} wait_queue_head_t;
+
+#define init_waitqueue_head(wq) do { \
+        pthread_mutex_init(&(wq)->lock, NULL); \
+        pthread_cond_init(&(wq)->cond, NULL); \
+    } while (0)
+
+/* Signals never interrupt the wait, there are none to deliver */
+#define wait_event_interruptible(wq, condition) ({ \
+        pthread_mutex_lock(&(wq).lock); \
+        while (!(condition)) \
+            pthread_cond_wait(&(wq).cond, &(wq).lock); \
+        pthread_mutex_unlock(&(wq).lock); \
+        0; \
+    })
+
+#define wake_up_interruptible(wq) do { \
+        pthread_mutex_lock(&(wq)->lock); \
+        pthread_cond_broadcast(&(wq)->cond); \
+        pthread_mutex_unlock(&(wq)->lock); \
+    } while (0)
+
+/*
+ * Files and buffers of a read or write
+ */
+struct cdev {
+    int unused;
+};
+
+struct inode {
+    struct cdev *i_cdev;
+};
+
+typedef unsigned int fmode_t;
+
+/* Makes the kernel serialize read() and lseek() on a shared file, nothing to do here */
+#define FMODE_ATOMIC_POS 0x8000
+
+struct file {
+    void *private_data;
+    loff_t f_pos;
+    unsigned int f_flags;
+    fmode_t f_mode;
+};
+
+struct kiocb {
+    struct file *ki_filp;
+    loff_t ki_pos;
+};
+
+struct kvec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+/* The direction is only checked by the kernel */
+#define ITER_SOURCE 1
+#define ITER_DEST 0
+
+/* An iov_iter over user or kernel buffers, which are both plain memory here */
+struct iov_iter {
+    const struct iovec *iov;
+    unsigned long nr_segs;
+    size_t iov_offset;
+    size_t count;
+};
+
+extern void iov_iter_init(struct iov_iter *i, unsigned int direction, const struct iovec *iov,
+            unsigned long nr_segs, size_t count);
+extern void iov_iter_kvec(struct iov_iter *i, unsigned int direction, const struct kvec *kvec,
+            unsigned long nr_segs, size_t count);
+extern size_t copy_from_iter(void *addr, size_t bytes, struct iov_iter *i);
+extern size_t copy_to_iter(const void *addr, size_t bytes, struct iov_iter *i);
+extern void iov_iter_revert(struct iov_iter *i, size_t bytes);
+
+static inline size_t iov_iter_count(const struct iov_iter *i)
+{
+    return i->count;
+}
+
+#endif /* AESD_KERNEL_SHIM_H */
@@ -35,13 +35,32 @@
 #include <sys/queue.h>
 #include <time.h>
 #include <errno.h>
+#include <poll.h>
+#include <stdint.h>
 #include "../aesd-char-driver/aesd_ioctl.h"
+#include "aesdsocket.h"
+#include "event_loop.h"
+#include "log_cache.h"
+#include "zerocopy.h"
+#include "packet_buffer.h"
+#include "pending_reply.h"
+#include "file_sink.h"
+#include "write_queue.h"
+#include "stats.h"
+#include "uring_loop.h"
 
 #define PORT "9000"
 #define BUFFER_SIZE 1024
+#define DEFAULT_BACKLOG 10
 #define USE_AESD_CHAR_DEVICE 1
+#define SEEKTO_PREFIX "AESDCHAR_IOCSEEKTO:"
+#define SEEKTO_PREFIX_LEN 19
+#define STATS_COMMAND "AESDSOCKET_STATS"
+#define STATS_COMMAND_LEN 16
+#define STATS_REPLY_SIZE 2048
+#define SEND_TIMEOUT_SEC 5          // A client taking no data for this long is dropped
 
-#ifdef USE_AESD_CHAR_DEVICE
+#if USE_AESD_CHAR_DEVICE
     #define FILE_PATH "/dev/aesdchar"
 #else
     #define FILE_PATH "/var/tmp/aesdsocketdata"
@@ -51,6 +70,10 @@
 // Global Variables
 volatile sig_atomic_t terminate_program = 0;
 int server_fd=-1;
+int epoll_mode = 0;       // Serve clients from the event loops instead of a thread each
+int zerocopy_replies = 0; // Send replies with sendfile/splice instead of through user memory
+int group_commit = 0;     // Write packets through the write queue instead of under file_mutex
+int uring_mode = 0;       // Serve clients from an io_uring per acceptor
 
 // Declaring Mutex Variables
 pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER; // Protects file write access
@@ -61,6 +84,11 @@ pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER; // Protects access to th
 pthread_t timer_thread_id;
 #endif
 
+/* Additional SO_REUSEPORT listeners, each served by an acceptor thread of its own */
+int *listener_fds;
+pthread_t *acceptor_ids;
+int acceptor_count;
+
 /* Structure to hold thread information */
 struct thread_info {
     pthread_t thread_id;
@@ -132,6 +160,132 @@ void daemonize() {
     open("/dev/null", O_WRONLY);  // stderr
 }
 
+void log_written(const char *data, size_t len)
+{
+    /* Nothing to do while the cache is disabled or not filled yet */
+    log_cache_append(data, len);
+}
+
+/*
+ * This function is used to commit a batch of queued packets to FILE_PATH from the writer
+ * thread, taking file_mutex once for the whole batch.
+ *
+ * Parameters:
+ *   iov: One buffer per packet, in the order the packets were queued
+ *   iovcnt: Number of packets
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+static int commit_packets(struct iovec *iov, int iovcnt)
+{
+    int ret;
+
+    stats_mutex_lock(&file_mutex);
+    /* Record the packets first, file_sink_writev() consumes iov */
+    for (int i = 0; i < iovcnt; i++) {
+        log_written(iov[i].iov_base, iov[i].iov_len);
+    }
+    ret = file_sink_writev(iov, iovcnt);
+    if (ret == -1) {
+        /* It is unknown how much of the batch made it to the file */
+        log_cache_invalidate();
+    }
+    pthread_mutex_unlock(&file_mutex);
+    return ret;
+}
+
+/*
+ * This function is used to append data to FILE_PATH, either directly under file_mutex or
+ * through the write queue in group commit mode.
+ *
+ * Parameters:
+ *   data: The data to write
+ *   len: Number of bytes to write
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+static int write_data(const char *data, size_t len)
+{
+    int ret;
+
+    if (group_commit) {
+        ret = write_queue_submit(data, len);
+    } else {
+        stats_mutex_lock(&file_mutex);
+        ret = file_sink_write(data, len);
+        if (ret == 0) {
+            log_written(data, len);
+        }
+        pthread_mutex_unlock(&file_mutex);
+    }
+    if (ret == 0) {
+        stats_add(STATS_BYTES_WRITTEN, len);
+    }
+    return ret;
+}
+
+int send_log(int client_fd)
+{
+    char buffer[BUFFER_SIZE];
+    struct log_snapshot *snap;
+    const char *data;
+    size_t len;
+    ssize_t read_bytes;
+    off_t offset = 0;
+    int ret = 0;
+
+    stats_add(STATS_REPLIES, 1);
+    if (zerocopy_replies) {
+        int file_fd = file_sink_fd();
+        if (file_fd == -1) {
+            return -1;
+        }
+        ret = zerocopy_send_file(client_fd, file_fd, &offset);
+        if (ret == 0 || errno != EINVAL) {
+            if (ret == -1) {
+                syslog(LOG_ERR, "Failed to send data to client");
+            }
+            return ret;
+        }
+        /* FILE_PATH supports neither sendfile nor splice, copy it instead */
+        ret = 0;
+    }
+
+    if (log_cache_enabled()) {
+        stats_mutex_lock(&file_mutex);
+        snap = log_cache_acquire(&data, &len);
+        pthread_mutex_unlock(&file_mutex);
+
+        if (snap) {
+            ret = send_all(client_fd, data, len) == -1 ? -1 : 0;
+            log_cache_release(snap);
+            if (ret == -1) {
+                syslog(LOG_ERR, "Failed to send data to client");
+            }
+            return ret;
+        }
+    }
+
+    offset = 0;
+    while ((read_bytes = file_sink_pread(buffer, BUFFER_SIZE, offset)) > 0) {
+        if (send_all(client_fd, buffer, read_bytes) == -1) {
+            syslog(LOG_ERR, "Failed to send data to client");
+            ret = -1;
+            break;
+        }
+        offset += read_bytes;
+    }
+    if (read_bytes == -1) {
+        syslog(LOG_ERR, "Failed to read file: %s", strerror(errno));
+        ret = -1;
+    }
+    return ret;
+}
+
 #if !USE_AESD_CHAR_DEVICE
 /*
  * This function is used to create and configure the timer thread for timestamps.
@@ -158,19 +312,10 @@ void *timer_thread(void *arg)
         // Format the timestamp in a compliant format
         strftime(timestamp, sizeof(timestamp), "timestamp:%a, %d %b %Y %H:%M:%S %z\n", tm_info);
         
-        // Ensure atomic write to the file using a mutex.
-        pthread_mutex_lock(&file_mutex);
-        int file_fd = open(FILE_PATH, O_WRONLY | O_APPEND | O_CREAT, 0644);
-        if (file_fd != -1) {
-            ssize_t ret = write(file_fd, timestamp, strlen(timestamp));
-            if(ret < 0) {
-                syslog(LOG_ERR, "Failed to write timestamp");
-            }
-            close(file_fd);
-        } else {
-            syslog(LOG_ERR, "Failed to open file for timestamp writing");
+        // Write the timestamp as one atomic append
+        if (write_data(timestamp, strlen(timestamp)) == -1) {
+            syslog(LOG_ERR, "Failed to write timestamp");
         }
-        pthread_mutex_unlock(&file_mutex);
     }
     return NULL;
 }
@@ -191,6 +336,7 @@ void thread_cleanup(void *arg)
     struct thread_info *tinfo = (struct thread_info *)arg;
     if (tinfo->client_fd != -1) {
         close(tinfo->client_fd);
+        stats_add(STATS_CONNECTIONS_CLOSED, 1);
     }
     pthread_mutex_lock(&list_mutex);
     LIST_REMOVE(tinfo, entries);
@@ -198,6 +344,20 @@ void thread_cleanup(void *arg)
     free(tinfo);
 }
 
+/*
+ * This is a Cleanup function releasing the packet buffer of a client thread.
+ *
+ * Parameters:
+ *   arg: Pointer to the packet_buffer structure of the thread
+ *
+ * Returns:
+ *   None
+ */
+static void packet_buffer_cleanup(void *arg)
+{
+    packet_buffer_free((struct packet_buffer *)arg);
+}
+
 /*
  * This is a Thread function to handle Client Connections.
  *
@@ -212,94 +372,426 @@ void *handle_client(void *arg)
 {
     struct thread_info *tinfo = (struct thread_info *)arg;
     int client_fd = tinfo->client_fd;
-    char buffer[BUFFER_SIZE];
+    struct packet_buffer pb;
+    const char *packet;
+    size_t packet_len, space;
     ssize_t bytes_received;
+    int failed = 0;
 
-    /* Register a cleanup handler to ensure thread cleanup on exit */
-    pthread_cleanup_push(thread_cleanup, tinfo);
+    packet_buffer_init(&pb);
 
-    int file_fd = open(FILE_PATH, O_CREAT | O_APPEND | O_RDWR, S_IRWXU | S_IRGRP | S_IROTH);
-    if (file_fd == -1) {
-        syslog(LOG_ERR, "Failed to open device file %s: %s", FILE_PATH, strerror(errno));
-    }
+    /* Register cleanup handlers to ensure thread cleanup on exit */
+    pthread_cleanup_push(thread_cleanup, tinfo);
+    pthread_cleanup_push(packet_buffer_cleanup, &pb);
 
-    while (1) {
-        bytes_received = recv(client_fd, buffer, BUFFER_SIZE, 0);
+    while (!failed) {
+        char *recv_ptr = packet_buffer_reserve(&pb, BUFFER_SIZE, &space);
+        if (!recv_ptr) {
+            syslog(LOG_ERR, "Failed to grow packet buffer");
+            break;
+        }
+        bytes_received = recv(client_fd, recv_ptr, space, 0);
         if (bytes_received <= 0) {
             break;
         }
+        stats_add(STATS_BYTES_IN, bytes_received);
+        packet_buffer_commit(&pb, bytes_received);
 
-        buffer[bytes_received] = '\0';
-
-        // Check for AESDCHAR_IOCSEEKTO:X,Y pattern
-        if (strncmp(buffer, "AESDCHAR_IOCSEEKTO:", 19) == 0) {
-            unsigned int write_cmd, write_cmd_offset;
-            if (sscanf(buffer + 19, "%u,%u", &write_cmd, &write_cmd_offset) == 2) {
-                if (file_fd < 0) {
-                    syslog(LOG_ERR, "Failed to open file for ioctl: %s", strerror(errno));
-                } else {
-                    struct aesd_seekto seekto;
-                    seekto.write_cmd = write_cmd;
-                    seekto.write_cmd_offset = write_cmd_offset;
-                    if (ioctl(file_fd, AESDCHAR_IOCSEEKTO, &seekto) < 0) {
-                        syslog(LOG_ERR, "Failed to perform ioctl: %s", strerror(errno));
-                    }
-
-                    char read_buf[BUFFER_SIZE];
-                    ssize_t n;
-                    while ((n = read(file_fd, read_buf, BUFFER_SIZE)) > 0)
-                    {
-                        send(tinfo->client_fd, read_buf, n, 0);
-                    }
-                    close(file_fd);
-                }
-            } else {
-                syslog(LOG_ERR, "Invalid ioctl command format from client");
+        /* Write and answer every complete packet received so far */
+        while (packet_buffer_next(&pb, &packet, &packet_len)) {
+            if (process_packet(client_fd, packet, packet_len) == -1) {
+                failed = 1;
+                break;
             }
+        }
+    }
+
+    /* Data without a trailing newline is still written once the client disconnects */
+    if (!failed && (packet_len = packet_buffer_take_partial(&pb, &packet)) > 0) {
+        process_packet(client_fd, packet, packet_len);
+    }
+
+    // The cleanup handlers will free the packet buffer, remove the thread info and free memory
+    pthread_cleanup_pop(1);
+    pthread_cleanup_pop(1);
+    return NULL;
+}
+
+
+int wait_writable(int client_fd)
+{
+    struct pollfd pfd = { .fd = client_fd, .events = POLLOUT };
+
+    /* Poll a second at a time so shutdown is noticed while waiting */
+    for (int waited = 0; waited < SEND_TIMEOUT_SEC; waited++) {
+        if (terminate_program) {
+            return -1;
+        }
+        int n = poll(&pfd, 1, 1000);
+        if (n > 0 || (n == -1 && errno == EINTR)) {
+            return 0;
+        }
+        if (n == -1) {
+            return -1;
+        }
+    }
+    syslog(LOG_ERR, "Client stopped reading replies, dropping it");
+    errno = ETIMEDOUT;
+    return -1;
+}
+
+ssize_t send_all(int client_fd, const void *buf, size_t len)
+{
+    const char *ptr = (const char *)buf;
+    struct pending_reply *pr = pending_reply_target();
+    size_t sent = 0;
+
+    /* Replies must reach the client in order, so queue behind anything already waiting */
+    if (pr && pending_reply_size(pr) > 0) {
+        return pending_reply_append(pr, buf, len) == -1 ? -1 : (ssize_t)len;
+    }
+
+    while (sent < len) {
+        ssize_t n = send(client_fd, ptr + sent, len - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            stats_add(STATS_BYTES_OUT, n);
+        } else if (n == -1 && errno == EINTR) {
             continue;
+        } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            /*
+             * Non-blocking socket with a full send buffer: hand the rest to the event loop if it
+             * keeps a backlog for this client, wait until the buffer drains otherwise
+             */
+            if (pr) {
+                return pending_reply_append(pr, ptr + sent, len - sent) == -1 ? -1 : (ssize_t)len;
+            }
+            if (wait_writable(client_fd) == -1) {
+                return -1;
+            }
+        } else {
+            return -1;
         }
+    }
+    return sent;
+}
+
+/*
+ * This function is used to handle an AESDCHAR_IOCSEEKTO:X,Y command by seeking the device
+ * and sending its contents from that position back to the client.
+ *
+ * Parameters:
+ *   client_fd: The client socket to reply on
+ *   packet: The received command, not necessarily NUL terminated
+ *   len: Length of the received command
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+static int process_seekto(int client_fd, const char *packet, size_t len)
+{
+    char cmd[64];
+    char read_buf[BUFFER_SIZE];
+    unsigned int write_cmd, write_cmd_offset;
+    ssize_t n;
+    int ret = 0;
 
-        /* Synchronize file writes using a mutex */
-        pthread_mutex_lock(&file_mutex);
+    if (len >= sizeof(cmd)) {
+        len = sizeof(cmd) - 1;
+    }
+    memcpy(cmd, packet, len);
+    cmd[len] = '\0';
 
-        // Open file for appending
-        if (file_fd == -1) {
-            syslog(LOG_ERR, "Failed to open file");
-            pthread_mutex_unlock(&file_mutex);
-            break;
+    if (sscanf(cmd + SEEKTO_PREFIX_LEN, "%u,%u", &write_cmd, &write_cmd_offset) != 2) {
+        syslog(LOG_ERR, "Invalid ioctl command format from client");
+        return 0;
+    }
+
+    stats_add(STATS_REPLIES, 1);
+
+    /* The ioctl moves the file position, so use a descriptor of our own */
+    int file_fd = file_sink_get_reader();
+    if (file_fd < 0) {
+        return 0;
+    }
+
+    struct aesd_seekto seekto;
+    seekto.write_cmd = write_cmd;
+    seekto.write_cmd_offset = write_cmd_offset;
+    if (ioctl(file_fd, AESDCHAR_IOCSEEKTO, &seekto) < 0) {
+        syslog(LOG_ERR, "Failed to perform ioctl: %s", strerror(errno));
+    }
+
+    if (zerocopy_replies) {
+        ret = zerocopy_send_file(client_fd, file_fd, NULL);
+        if (ret == 0 || errno != EINVAL) {
+            file_sink_put_reader(file_fd);
+            return ret;
         }
-        if (write(file_fd, buffer, bytes_received) == -1) {
-            syslog(LOG_ERR, "Failed to write to file");
-            close(file_fd);
-            pthread_mutex_unlock(&file_mutex);
+        ret = 0;
+    }
+
+    while ((n = read(file_fd, read_buf, BUFFER_SIZE)) > 0) {
+        if (send_all(client_fd, read_buf, n) == -1) {
+            ret = -1;
             break;
         }
-        close(file_fd);
-        pthread_mutex_unlock(&file_mutex);
+    }
+    file_sink_put_reader(file_fd);
+    return ret;
+}
 
-        /* If the received data ends with a newline, send the file content to the client */
-        if (buffer[bytes_received - 1] == '\n') {
-            int file_fd_read = open(FILE_PATH, O_RDONLY);
-            if (file_fd_read == -1) {
-                syslog(LOG_ERR, "Failed to open file for reading");
+/*
+ * This function is used to handle an AESDSOCKET_STATS command by sending the runtime
+ * statistics to the client instead of the file contents.
+ *
+ * Parameters:
+ *   client_fd: The client socket to reply on
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+static int process_stats(int client_fd)
+{
+    char reply[STATS_REPLY_SIZE];
+    size_t len = stats_format(reply, sizeof(reply));
+
+    stats_add(STATS_REPLIES, 1);
+    return send_all(client_fd, reply, len) == -1 ? -1 : 0;
+}
+
+/* Kinds of packets a client can send */
+enum packet_kind {
+    PACKET_DATA,        // Written to FILE_PATH
+    PACKET_SEEKTO,      // AESDCHAR_IOCSEEKTO:X,Y
+    PACKET_STATS,       // AESDSOCKET_STATS, never written to the file
+};
+
+/*
+ * This function is used to tell commands from data by their prefix.
+ */
+static enum packet_kind packet_kind(const char *packet, size_t len)
+{
+    if (len > SEEKTO_PREFIX_LEN && strncmp(packet, SEEKTO_PREFIX, SEEKTO_PREFIX_LEN) == 0) {
+        return PACKET_SEEKTO;
+    }
+    if (len >= STATS_COMMAND_LEN && strncmp(packet, STATS_COMMAND, STATS_COMMAND_LEN) == 0) {
+        return PACKET_STATS;
+    }
+    return PACKET_DATA;
+}
+
+int packet_is_command(const char *packet, size_t len)
+{
+    return packet_kind(packet, len) != PACKET_DATA;
+}
+
+/*
+ * This function is used to handle one packet, see process_packet().
+ */
+static int handle_packet(int client_fd, const char *packet, size_t len)
+{
+    int ret = 0;
+
+    switch (packet_kind(packet, len)) {
+    case PACKET_SEEKTO:
+        return process_seekto(client_fd, packet, len);
+    case PACKET_STATS:
+        return process_stats(client_fd);
+    default:
+        break;
+    }
+
+    /* Each packet is written as one atomic append */
+    if (write_data(packet, len) == -1) {
+        syslog(LOG_ERR, "Failed to write to file");
+        ret = -1;
+    }
+
+    /* If the packet ends with a newline, send the file content to the client */
+    if (ret == 0 && packet[len - 1] == '\n') {
+        ret = send_log(client_fd);
+    }
+    return ret;
+}
+
+int process_packet(int client_fd, const char *packet, size_t len)
+{
+    uint64_t start;
+    int ret;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    start = stats_now_ns();
+    ret = handle_packet(client_fd, packet, len);
+    stats_add(STATS_PACKETS, 1);
+    stats_record_latency(stats_now_ns() - start);
+    return ret;
+}
+
+
+/*
+ * This function is used to accept client connections on a listening socket until the program
+ * terminates, handing each one to the event loops or to a new client thread.
+ *
+ * Parameters:
+ *   listen_fd: The listening socket
+ *
+ * Returns:
+ *   None
+ */
+static void accept_clients(int listen_fd)
+{
+    struct sockaddr_storage client_addr;
+    socklen_t addr_len;
+
+    while (!terminate_program) {
+        // Accept connection
+        addr_len = sizeof(client_addr);
+        int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &addr_len);
+        if (client_fd == -1) {
+            if (terminate_program) {
                 break;
             }
-            ssize_t read_bytes;
-            while ((read_bytes = read(file_fd_read, buffer, BUFFER_SIZE)) > 0) {
-                if (send(client_fd, buffer, read_bytes, 0) == -1) {
-                    syslog(LOG_ERR, "Failed to send data to client");
-                    break;
-                }
-            }
-            close(file_fd_read);
+            syslog(LOG_ERR, "Accept failed");
+            continue;
+        }
+
+        stats_add(STATS_CONNECTIONS_ACCEPTED, 1);
+        struct sockaddr_in *client_in = (struct sockaddr_in *)&client_addr;
+        syslog(LOG_INFO, "Accepted connection from %s", inet_ntoa(client_in->sin_addr));
+
+        if (epoll_mode) {
+            event_loop_add_client(client_fd);
+            continue;
+        }
+
+        // Allocate a new thread_info structure for this connection
+        struct thread_info *tinfo = malloc(sizeof(struct thread_info));
+        if (!tinfo) {
+            syslog(LOG_ERR, "Failed to allocate memory for thread info");
+            close(client_fd);
+            continue;
         }
+        tinfo->client_fd = client_fd;
+
+        // Add the thread info to the global list
+        pthread_mutex_lock(&list_mutex);
+        LIST_INSERT_HEAD(&thread_list, tinfo, entries);
+        pthread_mutex_unlock(&list_mutex);
+
+         // Create a thread to handle the client
+         if (pthread_create(&tinfo->thread_id, NULL, handle_client, tinfo) != 0) {
+            syslog(LOG_ERR, "Failed to create thread");
+            pthread_mutex_lock(&list_mutex);
+            LIST_REMOVE(tinfo, entries);
+            pthread_mutex_unlock(&list_mutex);
+            close(client_fd);
+            free(tinfo);
+            continue;
+         }
     }
+}
 
-    // The cleanup handler will remove the thread info and free memory
-    pthread_cleanup_pop(1);
+/*
+ * This function is used to serve a listening socket with the io_uring engine if it was
+ * selected and works, and with the accept loop otherwise.
+ *
+ * Parameters:
+ *   listen_fd: The listening socket
+ *
+ * Returns:
+ *   None
+ */
+static void serve_listener(int listen_fd)
+{
+#ifdef HAVE_LIBURING
+    if (uring_mode && uring_loop_run(listen_fd) == 0) {
+        return;
+    }
+#endif
+    accept_clients(listen_fd);
+}
+
+/*
+ * This is the Thread function of an additional acceptor, serving its own SO_REUSEPORT
+ * listener.
+ *
+ * Parameters:
+ *   arg: The listening socket, cast to a pointer
+ *
+ * Returns:
+ *   NULL
+ */
+static void *acceptor_thread(void *arg)
+{
+    serve_listener((int)(intptr_t)arg);
     return NULL;
 }
 
+/*
+ * This function is used to create a listening socket bound to the given address.
+ *
+ * Parameters:
+ *   ai: The address to bind to
+ *   reuseport: Set SO_REUSEPORT so several sockets can share the port
+ *
+ * Returns:
+ *   On Success: The socket, bound but not listening yet
+ *   On Failure: -1
+ */
+static int open_listener(const struct addrinfo *ai, int reuseport)
+{
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd == -1) {
+        syslog(LOG_ERR, "Failed to create socket");
+        return -1;
+    }
+
+    // Set socket option to allow reuse of address and port
+    int optval = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1 ||
+        (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == -1)) {
+        syslog(LOG_ERR, "setsockopt failed");
+        close(fd);
+        return -1;
+    }
+
+    // Bind the socket to the address and port
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+        syslog(LOG_ERR, "Bind failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * This function is used to close the main and the additional listening sockets and release the
+ * acceptor arrays when the server fails to start.
+ *
+ * Parameters:
+ *   server_fd: The main listening socket
+ *   num_listeners: Number of additional listeners opened so far
+ *
+ * Returns:
+ *   None
+ */
+static void close_listeners(int server_fd, int num_listeners)
+{
+    for (int i = 0; i < num_listeners; i++) {
+        close(listener_fds[i]);
+    }
+    close(server_fd);
+    free(listener_fds);
+    free(acceptor_ids);
+    listener_fds = NULL;
+    acceptor_ids = NULL;
+}
 
 /*
  * This is the base function used for initiating the program execution.
@@ -315,9 +807,11 @@ void *handle_client(void *arg)
 int main(int argc, char *argv[]) 
 {
     struct addrinfo hints, *servinfo;
-    struct sockaddr_storage client_addr;
-    socklen_t addr_len = sizeof(client_addr);
-    int status, daemon_mode = 0;
+    int status, daemon_mode = 0, opt;
+    long num_loops = 1;
+    long num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    long num_acceptors = 1, backlog = -1;
+    int reuseport = 0;
 
     // Set up signal handling
     struct sigaction sa;
@@ -330,12 +824,86 @@ int main(int argc, char *argv[])
     // Open syslog
     openlog("aesdsocket", LOG_PID | LOG_PERROR, LOG_USER);
 
-    // Parse arguments to check for -d option
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-d") == 0) {
+    // Data file descriptors are opened on first use and kept until exit
+    file_sink_init(FILE_PATH);
+
+    #if USE_AESD_CHAR_DEVICE
+    /*
+     * The driver only keeps the most recent commands, so the log is not append-only and every
+     * write would invalidate the cache. Replies read the device without holding file_mutex.
+     */
+    log_cache_disable();
+    #endif
+
+    /*
+     * Parse arguments:
+     *   -a <n>   accept on n SO_REUSEPORT listeners, each with its own thread, so the kernel
+     *            spreads new connections across them (0 for one per online CPU)
+     *   -b <n>   listen backlog of each listener (default 10, SOMAXCONN with -a)
+     *   -d       run as a daemon
+     *   -e       serve clients from epoll event loops and a worker pool instead of a thread
+     *            per connection
+     *   -l <n>   number of event loops in -e mode (default 1)
+     *   -w <n>   number of workers in -e mode (default number of online CPUs)
+     *   -g       group commit packets from all clients through a single writer thread
+     *   -u       serve clients from io_uring, one ring per listener (needs liburing at build
+     *            time, takes precedence over -e)
+     *   -z       send replies with sendfile/splice instead of copying them through user memory
+     */
+    while ((opt = getopt(argc, argv, "a:b:degl:uw:z")) != -1) {
+        switch (opt) {
+        case 'a':
+            num_acceptors = strtol(optarg, NULL, 10);
+            if (num_acceptors == 0) {
+                num_acceptors = sysconf(_SC_NPROCESSORS_ONLN);
+            }
+            reuseport = 1;
+            break;
+        case 'b':
+            backlog = strtol(optarg, NULL, 10);
+            break;
+        case 'd':
             daemon_mode = 1;
+            break;
+        case 'e':
+            epoll_mode = 1;
+            break;
+        case 'g':
+            group_commit = 1;
+            break;
+        case 'l':
+            num_loops = strtol(optarg, NULL, 10);
+            break;
+        case 'u':
+#ifdef HAVE_LIBURING
+            uring_mode = 1;
+#else
+            syslog(LOG_WARNING, "Built without liburing, ignoring -u");
+#endif
+            break;
+        case 'w':
+            num_workers = strtol(optarg, NULL, 10);
+            break;
+        case 'z':
+            zerocopy_replies = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-a acceptors] [-b backlog] [-d] [-e] [-g] [-l loops] "
+                    "[-u] [-w workers] [-z]\n", argv[0]);
+            return -1;
         }
     }
+    if (num_loops < 1 || num_workers < 1) {
+        syslog(LOG_ERR, "Invalid number of event loops or workers");
+        return -1;
+    }
+    if (num_acceptors < 1) {
+        syslog(LOG_ERR, "Invalid number of acceptors");
+        return -1;
+    }
+    if (backlog < 1) {
+        backlog = reuseport ? SOMAXCONN : DEFAULT_BACKLOG;
+    }
 
     // Configure hints structure
     memset(&hints, 0, sizeof(hints));
@@ -349,31 +917,35 @@ int main(int argc, char *argv[])
         return -1;
     }
     
-    // Create socket
-    server_fd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol);
+    // Create and bind the main listener, served by the main thread
+    server_fd = open_listener(servinfo, reuseport);
     if (server_fd == -1) {
-        syslog(LOG_ERR, "Failed to create socket");
         freeaddrinfo(servinfo);
         return -1;
     }
 
-    // Set socket option to allow reuse of address and port
-    int optval = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1) {
-        syslog(LOG_ERR, "setsockopt failed");
-        close(server_fd);
-        freeaddrinfo(servinfo);
-        return -1;
+    // Bind the additional listeners now so errors show up before daemonizing
+    if (num_acceptors > 1) {
+        listener_fds = calloc(num_acceptors - 1, sizeof(*listener_fds));
+        acceptor_ids = calloc(num_acceptors - 1, sizeof(*acceptor_ids));
+        if (!listener_fds || !acceptor_ids) {
+            syslog(LOG_ERR, "Failed to allocate memory for acceptors");
+            free(listener_fds);
+            free(acceptor_ids);
+            listener_fds = NULL;
+            acceptor_ids = NULL;
+            num_acceptors = 1;
+        }
     }
-    
-    // Bind the socket to the address and port
-    if (bind(server_fd, servinfo->ai_addr, servinfo->ai_addrlen) == -1) {
-        syslog(LOG_ERR, "Bind failed");
-        close(server_fd);
-        freeaddrinfo(servinfo);
-        return -1;
+    for (int i = 0; i < num_acceptors - 1; i++) {
+        listener_fds[i] = open_listener(servinfo, reuseport);
+        if (listener_fds[i] == -1) {
+            close_listeners(server_fd, i);
+            freeaddrinfo(servinfo);
+            return -1;
+        }
     }
-    
+
     // Issue freeaddrinfo after bind step
     freeaddrinfo(servinfo);
 
@@ -383,67 +955,86 @@ int main(int argc, char *argv[])
     }
     
     // Listen for connections
-    if (listen(server_fd, 10) == -1) {
+    if (listen(server_fd, backlog) == -1) {
         syslog(LOG_ERR, "Listen failed");
-        close(server_fd);
+        close_listeners(server_fd, num_acceptors - 1);
         return -1;
     }
+    for (int i = 0; i < num_acceptors - 1; i++) {
+        if (listen(listener_fds[i], backlog) == -1) {
+            syslog(LOG_ERR, "Listen failed");
+            close_listeners(server_fd, num_acceptors - 1);
+            return -1;
+        }
+    }
 
     /* Initialize the global thread list */
     LIST_INIT(&thread_list);
 
+    if (group_commit && write_queue_start(commit_packets) == -1) {
+        close_listeners(server_fd, num_acceptors - 1);
+        return -1;
+    }
+
+    if (epoll_mode && event_loop_start(num_loops, num_workers) == -1) {
+        if (group_commit) {
+            write_queue_stop();
+        }
+        close_listeners(server_fd, num_acceptors - 1);
+        return -1;
+    }
+
     #if !USE_AESD_CHAR_DEVICE
     /* Create the timer thread to write timestamps every 10 seconds */
     if (pthread_create(&timer_thread_id, NULL, timer_thread, NULL) != 0) {
         syslog(LOG_ERR, "Failed to create timer thread");
     }
     #endif
-    
-    // Main server loop to handle incoming connections
-    while (!terminate_program) {
-        // Accept connection
-        int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &addr_len);
-        if (client_fd == -1) {
-            if (terminate_program) {
-                break;
-            }
-            syslog(LOG_ERR, "Accept failed");
-            continue;
-        }
-
-        struct sockaddr_in *client_in = (struct sockaddr_in *)&client_addr;
-        syslog(LOG_INFO, "Accepted connection from %s", inet_ntoa(client_in->sin_addr));
 
-        // Allocate a new thread_info structure for this connection
-        struct thread_info *tinfo = malloc(sizeof(struct thread_info));
-        if (!tinfo) {
-            syslog(LOG_ERR, "Failed to allocate memory for thread info");
-            close(client_fd);
-            continue;
+    /* Start one acceptor per additional listener, only the main thread handles signals */
+    sigset_t block_set, old_set;
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    sigaddset(&block_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+    for (acceptor_count = 0; acceptor_count < num_acceptors - 1; acceptor_count++) {
+        if (pthread_create(&acceptor_ids[acceptor_count], NULL, acceptor_thread,
+                           (void *)(intptr_t)listener_fds[acceptor_count]) != 0) {
+            syslog(LOG_ERR, "Failed to create acceptor thread");
+            break;
         }
-        tinfo->client_fd = client_fd;
-
-        // Add the thread info to the global list
-        pthread_mutex_lock(&list_mutex);
-        LIST_INSERT_HEAD(&thread_list, tinfo, entries);
-        pthread_mutex_unlock(&list_mutex);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    for (int i = acceptor_count; i < num_acceptors - 1; i++) {
+        close(listener_fds[i]);
+    }
+    if (reuseport) {
+        syslog(LOG_INFO, "Accepting on %d SO_REUSEPORT listeners with backlog %ld",
+               acceptor_count + 1, backlog);
+    }
+    
+    // Main server loop to handle incoming connections
+    serve_listener(server_fd);
 
-         // Create a thread to handle the client
-         if (pthread_create(&tinfo->thread_id, NULL, handle_client, tinfo) != 0) {
-            syslog(LOG_ERR, "Failed to create thread");
-            pthread_mutex_lock(&list_mutex);
-            LIST_REMOVE(tinfo, entries);
-            pthread_mutex_unlock(&list_mutex);
-            close(client_fd);
-            free(tinfo);
-            continue;
-         }
+    /* Wake the other acceptors, shutdown() makes a blocked accept() fail */
+    for (int i = 0; i < acceptor_count; i++) {
+        shutdown(listener_fds[i], SHUT_RDWR);
+    }
+    for (int i = 0; i < acceptor_count; i++) {
+        pthread_join(acceptor_ids[i], NULL);
+        close(listener_fds[i]);
     }
+    free(acceptor_ids);
+    free(listener_fds);
 
     if (server_fd != -1){
         close(server_fd);
     }
 
+    if (epoll_mode) {
+        event_loop_stop();
+    }
+
     #if !USE_AESD_CHAR_DEVICE
     /* Cancel and join the timer thread */
     pthread_cancel(timer_thread_id);
@@ -465,6 +1056,21 @@ int main(int argc, char *argv[])
     }
     pthread_mutex_unlock(&list_mutex);
 
+    /* All clients are gone, so nothing can be queued any more */
+    if (group_commit) {
+        unsigned long packets, commits;
+        write_queue_stop();
+        write_queue_get_stats(&packets, &commits);
+        syslog(LOG_INFO, "Group committed %lu packets in %lu writes", packets, commits);
+    }
+
+    log_cache_invalidate();
+
+    unsigned long fd_opens, fd_closes;
+    file_sink_close();
+    file_sink_get_stats(&fd_opens, &fd_closes);
+    syslog(LOG_INFO, "Data file descriptors opened: %lu, closed: %lu", fd_opens, fd_closes);
+
     #if !USE_AESD_CHAR_DEVICE
     remove(FILE_PATH);
     #endif
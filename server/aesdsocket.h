@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    aesdsocket.h
+ * @brief   This header file declares the state and helpers shared between the aesdsocket
+ *          connection handling modes.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef AESDSOCKET_H
+#define AESDSOCKET_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/* Set by the signal handler once the server should shut down */
+extern volatile sig_atomic_t terminate_program;
+
+/* Protects writes to FILE_PATH and the log cache */
+extern pthread_mutex_t file_mutex;
+
+/*
+ * Keeps the log cache coherent after data was written to FILE_PATH. The caller must hold
+ * file_mutex.
+ */
+void log_written(const char *data, size_t len);
+
+/*
+ * Sends the full contents of FILE_PATH to the client, from the log cache when possible and
+ * by streaming the file otherwise.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+int send_log(int client_fd);
+
+/*
+ * Waits for a non-blocking client socket to become writable, giving up after a few seconds.
+ *
+ * Returns:
+ *   On Success: 0 (the caller should retry the send)
+ *   On Failure: -1 (the server is shutting down, poll failed or the client timed out)
+ */
+int wait_writable(int client_fd);
+
+/*
+ * Sends the whole buffer to the client, retrying on partial sends. If a non-blocking socket is
+ * full, what is left goes to the reply backlog of the calling thread if it has one (see
+ * pending_reply_set_target()), otherwise send_all() waits for the socket to become writable.
+ *
+ * Returns:
+ *   On Success: Number of bytes sent or queued (len)
+ *   On Failure: -1
+ */
+ssize_t send_all(int client_fd, const void *buf, size_t len);
+
+/*
+ * Handles one packet received from a client: either an AESDCHAR_IOCSEEKTO command, an
+ * AESDSOCKET_STATS command or data which is appended to FILE_PATH, followed by the file
+ * contents being sent back if the packet is newline terminated.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1 (the connection should be closed)
+ */
+int process_packet(int client_fd, const char *packet, size_t len);
+
+/*
+ * Returns whether a packet is a command (AESDCHAR_IOCSEEKTO or AESDSOCKET_STATS) rather than
+ * data to be written to FILE_PATH.
+ */
+int packet_is_command(const char *packet, size_t len);
+
+#endif /* AESDSOCKET_H */
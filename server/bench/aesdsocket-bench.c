@@ -0,0 +1,536 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    aesdsocket-bench.c
+ * @brief   This file implements a load generator and latency benchmark for aesdsocket.
+ *
+ * Every connection runs in its own thread and sends newline terminated packets of the form
+ * "B<conn>:<seq>:<padding>\n", where the padding is derived from conn and seq so any packet
+ * seen in a reply can be checked. The round-trip latency of a packet is the time from
+ * sending it until it shows up in the reply stream of its connection. Replies contain the
+ * whole log, so every line starting with 'B' is validated, while other lines (timestamps,
+ * data from other clients) are skipped.
+ *
+ * The results are printed as a single JSON object on stdout. The exit status is non-zero if
+ * any packet was lost, timed out or any echoed packet was corrupt.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT "9000"
+#define RECV_CHUNK_SIZE 65536
+#define NSEC_PER_SEC 1000000000ULL
+#define PACKET_HEADER_MAX 32        // "B<conn>:<seq>:\n" with two 32 bit numbers
+
+/* Benchmark settings shared by all connections */
+struct bench_config {
+    const char *host;
+    const char *port;
+    unsigned int connections;
+    unsigned int packets;       // Packets sent by each connection
+    size_t packet_size;         // Bytes per packet, including the newline
+    double rate;                // Packets per second per connection, 0 for as fast as possible
+    int timeout_ms;             // Longest wait for a packet to be echoed
+};
+
+/* Structure to hold the state and results of one connection */
+struct bench_conn {
+    pthread_t thread_id;
+    unsigned int id;
+    const struct bench_config *cfg;
+    int sock_fd;
+
+    char *line;                 // Partial reply line carried over between recv() calls
+    size_t line_len;
+    size_t line_cap;
+
+    uint64_t *latencies;        // Round-trip time of each echoed packet, in nanoseconds
+    unsigned int echoed;
+    unsigned int timeouts;
+    unsigned long corrupt;
+    int failed;                 // Connect, send or recv error
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+};
+
+/*
+ * Returns the current monotonic time in nanoseconds.
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * Returns the padding character at position i of packet seq of connection conn.
+ */
+static char padding_char(unsigned int conn, unsigned int seq, size_t i)
+{
+    return 'a' + (conn * 31 + seq * 7 + i) % 26;
+}
+
+/*
+ * Builds packet seq of connection conn into buf, which must hold at least the larger of size
+ * and PACKET_HEADER_MAX bytes.
+ *
+ * Returns:
+ *   Length of the packet, which is larger than size only if the header does not fit
+ */
+static size_t build_packet(char *buf, size_t size, unsigned int conn, unsigned int seq)
+{
+    size_t len = sprintf(buf, "B%u:%u:", conn, seq);
+
+    for (size_t i = 0; len + 1 < size; i++) {
+        buf[len++] = padding_char(conn, seq, i);
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+/*
+ * Checks a reply line (without its newline) which starts with 'B'.
+ *
+ * Parameters:
+ *   line: The line to check
+ *   len: Length of the line
+ *   conn: Set to the connection which sent the packet
+ *   seq: Set to the sequence number of the packet
+ *
+ * Returns:
+ *   1 if the line is an intact benchmark packet, 0 if it is corrupt
+ */
+static int parse_packet(const char *line, size_t len, unsigned int *conn, unsigned int *seq)
+{
+    char *end;
+    size_t pos;
+
+    *conn = strtoul(line + 1, &end, 10);
+    if (end == line + 1 || (size_t)(end - line) >= len || *end != ':') {
+        return 0;
+    }
+    const char *seq_start = end + 1;
+    *seq = strtoul(seq_start, &end, 10);
+    if (end == seq_start || (size_t)(end - line) >= len || *end != ':') {
+        return 0;
+    }
+    pos = end - line + 1;
+    for (size_t i = 0; pos < len; i++, pos++) {
+        if (line[pos] != padding_char(*conn, *seq, i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Sends the whole buffer on the connection socket.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+static int send_packet(struct bench_conn *c, const char *buf, size_t len)
+{
+    size_t sent = 0;
+
+    while (sent < len) {
+        ssize_t n = send(c->sock_fd, buf + sent, len - sent, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    c->bytes_sent += len;
+    return 0;
+}
+
+/*
+ * Handles one complete reply line of a connection.
+ *
+ * Returns:
+ *   1 if the line is the packet the connection waits for, 0 otherwise
+ */
+static int handle_line(struct bench_conn *c, const char *line, size_t len, unsigned int waiting)
+{
+    unsigned int conn, seq;
+
+    if (len == 0 || line[0] != 'B') {
+        return 0;
+    }
+    if (!parse_packet(line, len, &conn, &seq)) {
+        c->corrupt++;
+        return 0;
+    }
+    return conn == c->id && seq == waiting;
+}
+
+/*
+ * Receives from the connection until packet seq has been echoed, the timeout expires or the
+ * connection fails. Complete lines received along with the packet are checked and dropped, only
+ * a trailing partial line carries over to the next call in c->line.
+ *
+ * Returns:
+ *   1 if the packet was echoed, 0 on timeout, -1 on error or EOF
+ */
+static int wait_echo(struct bench_conn *c, unsigned int seq, uint64_t deadline)
+{
+    static __thread char chunk[RECV_CHUNK_SIZE];
+    struct pollfd pfd = { .fd = c->sock_fd, .events = POLLIN };
+
+    while (1) {
+        uint64_t now = now_ns();
+        if (now >= deadline) {
+            return 0;
+        }
+        int ret = poll(&pfd, 1, (deadline - now) / 1000000 + 1);
+        if (ret == -1 && errno != EINTR) {
+            return -1;
+        }
+        if (ret <= 0) {
+            continue;
+        }
+
+        ssize_t n = recv(c->sock_fd, chunk, sizeof(chunk), 0);
+        if (n == 0 || (n == -1 && errno != EINTR)) {
+            return -1;
+        }
+        if (n == -1) {
+            continue;
+        }
+        c->bytes_received += n;
+
+        /* Split into lines, carrying a partial last line over in c->line */
+        int found = 0;
+        char *start = chunk;
+        char *end = chunk + n;
+        while (start < end) {
+            char *nl = memchr(start, '\n', end - start);
+            size_t part = (nl ? nl : end) - start;
+            if (c->line_len + part > c->line_cap) {
+                size_t cap = c->line_cap ? c->line_cap : 256;
+                while (cap < c->line_len + part) {
+                    cap *= 2;
+                }
+                char *line = realloc(c->line, cap);
+                if (!line) {
+                    return -1;
+                }
+                c->line = line;
+                c->line_cap = cap;
+            }
+            memcpy(c->line + c->line_len, start, part);
+            c->line_len += part;
+            if (!nl) {
+                break;
+            }
+            if (handle_line(c, c->line, c->line_len, seq)) {
+                found = 1;
+            }
+            c->line_len = 0;
+            start = nl + 1;
+        }
+        if (found) {
+            return 1;
+        }
+    }
+}
+
+/*
+ * Opens a TCP connection to the server.
+ *
+ * Returns:
+ *   On Success: The socket
+ *   On Failure: -1
+ */
+static int connect_server(const char *host, const char *port)
+{
+    struct addrinfo hints, *res, *ai;
+    int fd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        return -1;
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == -1) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+/*
+ * This is the Thread function of a connection, which sends its packets at the configured
+ * rate and records the round-trip time of each.
+ *
+ * Parameters:
+ *   arg: Pointer to the bench_conn structure of this connection
+ *
+ * Returns:
+ *   NULL
+ */
+static void *conn_thread(void *arg)
+{
+    struct bench_conn *c = (struct bench_conn *)arg;
+    const struct bench_config *cfg = c->cfg;
+    size_t buf_size = cfg->packet_size > PACKET_HEADER_MAX ? cfg->packet_size : PACKET_HEADER_MAX;
+    char *buf = malloc(buf_size);
+    uint64_t start, interval = 0;
+
+    if (!buf) {
+        c->failed = 1;
+        return NULL;
+    }
+    if (cfg->rate > 0) {
+        interval = (uint64_t)(NSEC_PER_SEC / cfg->rate);
+    }
+
+    start = now_ns();
+    for (unsigned int seq = 0; seq < cfg->packets; seq++) {
+        /* Pace against the start time so a slow reply does not lower the offered rate */
+        if (interval) {
+            uint64_t due = start + seq * interval;
+            uint64_t now = now_ns();
+            if (due > now) {
+                struct timespec ts = { (due - now) / NSEC_PER_SEC, (due - now) % NSEC_PER_SEC };
+                nanosleep(&ts, NULL);
+            }
+        }
+
+        size_t len = build_packet(buf, cfg->packet_size, c->id, seq);
+        uint64_t sent_at = now_ns();
+        if (send_packet(c, buf, len) == -1) {
+            c->failed = 1;
+            break;
+        }
+
+        int ret = wait_echo(c, seq, sent_at + (uint64_t)cfg->timeout_ms * 1000000);
+        if (ret == 1) {
+            c->latencies[c->echoed++] = now_ns() - sent_at;
+        } else if (ret == 0) {
+            c->timeouts++;
+        } else {
+            c->failed = 1;
+            break;
+        }
+    }
+
+    /* Let the server finish the last reply and close before we do */
+    shutdown(c->sock_fd, SHUT_WR);
+    while (recv(c->sock_fd, buf, buf_size, 0) > 0);
+
+    free(buf);
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Returns the latency at the given permille of the sorted samples, in microseconds.
+ */
+static double percentile_us(const uint64_t *sorted, size_t count, unsigned int permille)
+{
+    if (count == 0) {
+        return 0;
+    }
+    size_t idx = (count * permille + 999) / 1000;
+    if (idx > 0) {
+        idx--;
+    }
+    return sorted[idx] / 1000.0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-H host] [-p port] [-c connections] [-n packets] [-s size] [-r rate]"
+            " [-t timeout_ms]\n"
+            "  -c  concurrent connections (default 8)\n"
+            "  -n  packets sent by each connection (default 100)\n"
+            "  -s  packet size in bytes, including the newline (default 64)\n"
+            "  -r  packets per second per connection, 0 for unlimited (default 0)\n"
+            "  -t  time to wait for each packet to be echoed (default 5000)\n",
+            prog);
+}
+
+/*
+ * This is the base function used for initiating the program execution.
+ *
+ * Parameters:
+ *   argc: The number of command-line arguments passed to the program.
+ *   argv: The array of command-line argument strings.
+ *
+ * Returns:
+ *   0 if every packet was echoed intact, 1 otherwise
+ */
+int main(int argc, char *argv[])
+{
+    struct bench_config cfg = {
+        .host = DEFAULT_HOST,
+        .port = DEFAULT_PORT,
+        .connections = 8,
+        .packets = 100,
+        .packet_size = 64,
+        .rate = 0,
+        .timeout_ms = 5000,
+    };
+    struct bench_conn *conns;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:c:n:s:r:t:")) != -1) {
+        switch (opt) {
+        case 'H':
+            cfg.host = optarg;
+            break;
+        case 'p':
+            cfg.port = optarg;
+            break;
+        case 'c':
+            cfg.connections = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            cfg.packets = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            cfg.packet_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            cfg.rate = strtod(optarg, NULL);
+            break;
+        case 't':
+            cfg.timeout_ms = strtol(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.connections < 1 || cfg.packets < 1 || cfg.packet_size < 2 || cfg.rate < 0 ||
+        cfg.timeout_ms < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    conns = calloc(cfg.connections, sizeof(*conns));
+    if (!conns) {
+        perror("calloc");
+        return 2;
+    }
+
+    /* Connect everything first so connection setup is not part of the measurement */
+    for (unsigned int i = 0; i < cfg.connections; i++) {
+        conns[i].id = i;
+        conns[i].cfg = &cfg;
+        conns[i].latencies = malloc(cfg.packets * sizeof(uint64_t));
+        conns[i].sock_fd = connect_server(cfg.host, cfg.port);
+        if (!conns[i].latencies || conns[i].sock_fd == -1) {
+            fprintf(stderr, "Failed to connect to %s:%s\n", cfg.host, cfg.port);
+            return 2;
+        }
+    }
+
+    uint64_t start = now_ns();
+    for (unsigned int i = 0; i < cfg.connections; i++) {
+        if (pthread_create(&conns[i].thread_id, NULL, conn_thread, &conns[i]) != 0) {
+            fprintf(stderr, "Failed to create connection thread\n");
+            return 2;
+        }
+    }
+    for (unsigned int i = 0; i < cfg.connections; i++) {
+        pthread_join(conns[i].thread_id, NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    /* Merge the results of all connections */
+    size_t total = (size_t)cfg.connections * cfg.packets;
+    uint64_t *all = malloc(total * sizeof(uint64_t));
+    size_t echoed = 0;
+    unsigned long timeouts = 0, corrupt = 0, failed = 0;
+    uint64_t bytes_sent = 0, bytes_received = 0, sum = 0;
+
+    if (!all) {
+        perror("malloc");
+        return 2;
+    }
+    for (unsigned int i = 0; i < cfg.connections; i++) {
+        struct bench_conn *c = &conns[i];
+        memcpy(all + echoed, c->latencies, c->echoed * sizeof(uint64_t));
+        echoed += c->echoed;
+        timeouts += c->timeouts;
+        corrupt += c->corrupt;
+        failed += c->failed;
+        bytes_sent += c->bytes_sent;
+        bytes_received += c->bytes_received;
+        close(c->sock_fd);
+        free(c->latencies);
+        free(c->line);
+    }
+    qsort(all, echoed, sizeof(uint64_t), compare_u64);
+    for (size_t i = 0; i < echoed; i++) {
+        sum += all[i];
+    }
+
+    double seconds = elapsed / (double)NSEC_PER_SEC;
+    printf("{\"connections\":%u,\"packets_per_connection\":%u,\"packet_size\":%zu,"
+           "\"rate\":%.1f,\"elapsed_s\":%.6f,"
+           "\"packets_sent\":%zu,\"packets_echoed\":%zu,\"timeouts\":%lu,"
+           "\"corrupt_lines\":%lu,\"failed_connections\":%lu,"
+           "\"bytes_sent\":%llu,\"bytes_received\":%llu,"
+           "\"throughput_pps\":%.1f,\"tx_mbps\":%.3f,\"rx_mbps\":%.3f,"
+           "\"latency_us\":{\"min\":%.1f,\"mean\":%.1f,\"p50\":%.1f,\"p99\":%.1f,"
+           "\"p999\":%.1f,\"max\":%.1f}}\n",
+           cfg.connections, cfg.packets, cfg.packet_size, cfg.rate, seconds,
+           total, echoed, timeouts, corrupt, failed,
+           (unsigned long long)bytes_sent, (unsigned long long)bytes_received,
+           echoed / seconds, bytes_sent * 8 / seconds / 1e6, bytes_received * 8 / seconds / 1e6,
+           echoed ? all[0] / 1000.0 : 0, echoed ? sum / (double)echoed / 1000.0 : 0,
+           percentile_us(all, echoed, 500), percentile_us(all, echoed, 990),
+           percentile_us(all, echoed, 999), echoed ? all[echoed - 1] / 1000.0 : 0);
+
+    free(all);
+    free(conns);
+    return (echoed == total && corrupt == 0 && failed == 0) ? 0 : 1;
+}
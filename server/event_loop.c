@@ -0,0 +1,472 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    event_loop.c
+ * @brief   This file implements the epoll event loop mode of aesdsocket.
+ *
+ * Each loop thread owns a set of non-blocking client sockets registered edge-triggered and
+ * one-shot. When a socket has delivered at least one newline terminated packet (or hit EOF),
+ * the connection is handed to the bounded worker queue without re-arming it, so exactly one
+ * thread owns a connection at any time and packets of a connection are processed in order.
+ * The worker re-arms the socket once all complete packets have been processed.
+ *
+ * Workers never wait for a slow client: a reply the socket cannot take is kept on the connection,
+ * which is then re-armed for EPOLLOUT only, so no further packets are read until the loop thread
+ * has sent the rest of the reply.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "aesdsocket.h"
+#include "event_loop.h"
+#include "packet_buffer.h"
+#include "pending_reply.h"
+#include "stats.h"
+
+#define WORK_QUEUE_DEPTH 1024
+#define READ_CHUNK_SIZE 4096
+#define MAX_EVENTS 64
+
+/* Structure to hold the state of one client connection */
+struct connection {
+    int client_fd;
+    int epoll_fd;       // epoll instance of the owning loop
+    struct packet_buffer pb;
+    struct pending_reply reply; // reply bytes the socket has not taken yet
+    int eof;            // peer closed the connection or a socket error was seen
+    LIST_ENTRY(connection) entries;
+};
+
+LIST_HEAD(connection_list, connection);
+
+/* Structure to hold one epoll loop thread */
+struct event_loop {
+    pthread_t thread_id;
+    int epoll_fd;
+};
+
+static struct event_loop *loops;
+static int loop_count;
+static atomic_uint next_loop;     // Shared by all acceptors
+static pthread_t *workers;
+static int worker_count;
+static int wakeup_fd = -1;
+static volatile int stopping;
+
+/* All live connections, used to release them on shutdown */
+static struct connection_list connections = LIST_HEAD_INITIALIZER(connections);
+static pthread_mutex_t connections_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Bounded queue of connections with complete packets waiting for a worker */
+static struct connection *work_queue[WORK_QUEUE_DEPTH];
+static size_t queue_head;
+static size_t queue_count;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_not_full = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Pushes a connection onto the work queue, blocking while the queue is full.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1 (the event loop is stopping)
+ */
+static int queue_push(struct connection *conn)
+{
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_count == WORK_QUEUE_DEPTH && !stopping) {
+        pthread_cond_wait(&queue_not_full, &queue_mutex);
+    }
+    if (stopping) {
+        pthread_mutex_unlock(&queue_mutex);
+        return -1;
+    }
+    work_queue[(queue_head + queue_count) % WORK_QUEUE_DEPTH] = conn;
+    queue_count++;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_mutex);
+    return 0;
+}
+
+/*
+ * Pops a connection from the work queue, blocking while the queue is empty.
+ *
+ * Returns:
+ *   On Success: The connection to serve
+ *   On Failure: NULL (the event loop is stopping)
+ */
+static struct connection *queue_pop(void)
+{
+    struct connection *conn = NULL;
+
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_count == 0 && !stopping) {
+        pthread_cond_wait(&queue_not_empty, &queue_mutex);
+    }
+    if (!stopping) {
+        conn = work_queue[queue_head];
+        queue_head = (queue_head + 1) % WORK_QUEUE_DEPTH;
+        queue_count--;
+        pthread_cond_signal(&queue_not_full);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return conn;
+}
+
+/*
+ * Closes the client socket of a connection and releases it.
+ */
+static void close_connection(struct connection *conn)
+{
+    pthread_mutex_lock(&connections_mutex);
+    LIST_REMOVE(conn, entries);
+    pthread_mutex_unlock(&connections_mutex);
+    close(conn->client_fd);
+    stats_add(STATS_CONNECTIONS_CLOSED, 1);
+    packet_buffer_free(&conn->pb);
+    pending_reply_free(&conn->reply);
+    free(conn);
+}
+
+/*
+ * Re-enables the one-shot epoll registration of a connection, waiting for the socket to become
+ * writable while part of a reply is pending and readable otherwise. Once this returns the owning
+ * loop may pick the connection up again, so the caller must not touch it afterwards.
+ */
+static int rearm_connection(struct connection *conn)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLET | EPOLLONESHOT;
+    ev.events |= pending_reply_size(&conn->reply) > 0 ? EPOLLOUT : EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    return epoll_ctl(conn->epoll_fd, EPOLL_CTL_MOD, conn->client_fd, &ev);
+}
+
+/*
+ * Reads from a client socket until it would block, EOF is reached or a complete packet has
+ * been buffered. Stopping early is safe since re-arming a one-shot registration re-evaluates
+ * the readiness of the socket.
+ *
+ * Returns:
+ *   1 if the connection has work for a worker (a complete packet or EOF), 0 otherwise
+ */
+static int read_client(struct connection *conn)
+{
+    size_t space;
+
+    while (!conn->eof && !packet_buffer_has_packet(&conn->pb)) {
+        char *recv_ptr = packet_buffer_reserve(&conn->pb, READ_CHUNK_SIZE, &space);
+        if (!recv_ptr) {
+            syslog(LOG_ERR, "Failed to grow packet buffer");
+            conn->eof = 1;
+            break;
+        }
+
+        ssize_t n = recv(conn->client_fd, recv_ptr, space, 0);
+        if (n > 0) {
+            stats_add(STATS_BYTES_IN, n);
+            packet_buffer_commit(&conn->pb, n);
+        } else if (n == 0) {
+            conn->eof = 1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            conn->eof = 1;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Processes the complete packets buffered for a connection until one of them leaves part of its
+ * reply pending, then either re-arms the connection or closes it if the client has gone away.
+ */
+static void serve_connection(struct connection *conn)
+{
+    const char *packet;
+    size_t packet_len;
+    int failed = 0;
+
+    pending_reply_set_target(&conn->reply);
+    while (!failed && pending_reply_size(&conn->reply) == 0 &&
+           packet_buffer_next(&conn->pb, &packet, &packet_len)) {
+        if (process_packet(conn->client_fd, packet, packet_len) == -1) {
+            failed = 1;
+        }
+    }
+
+    /* Data without a trailing newline is still written once the client disconnects */
+    if (!failed && conn->eof && pending_reply_size(&conn->reply) == 0 &&
+        (packet_len = packet_buffer_take_partial(&conn->pb, &packet)) > 0) {
+        process_packet(conn->client_fd, packet, packet_len);
+    }
+    pending_reply_set_target(NULL);
+
+    /* With a reply pending the loop comes back here once it is sent, even after EOF */
+    if (failed || (conn->eof && pending_reply_size(&conn->reply) == 0) ||
+        rearm_connection(conn) == -1) {
+        close_connection(conn);
+    }
+}
+
+/*
+ * Sends the pending reply of a connection from its loop thread.
+ *
+ * Returns:
+ *   1 if nothing is pending any more, 0 if the connection has been re-armed or closed
+ */
+static int flush_connection(struct connection *conn)
+{
+    int ret = pending_reply_flush(&conn->reply, conn->client_fd);
+
+    if (ret == -1 || (ret == 0 && rearm_connection(conn) == -1)) {
+        close_connection(conn);
+        return 0;
+    }
+    return ret;
+}
+
+/*
+ * This is the Thread function of an epoll loop, which reads from its ready sockets and hands
+ * connections with complete packets to the worker pool.
+ *
+ * Parameters:
+ *   arg: Pointer to the event_loop structure of this thread
+ *
+ * Returns:
+ *   NULL
+ */
+static void *event_loop_thread(void *arg)
+{
+    struct event_loop *loop = (struct event_loop *)arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!stopping) {
+        int n = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_ERR, "epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n && !stopping; i++) {
+            struct connection *conn = events[i].data.ptr;
+            if (conn == NULL) {
+                continue; // Wakeup eventfd
+            }
+            if (pending_reply_size(&conn->reply) > 0 && !flush_connection(conn)) {
+                continue;
+            }
+            if (!read_client(conn)) {
+                if (rearm_connection(conn) == -1) {
+                    close_connection(conn);
+                }
+            } else if (queue_push(conn) == -1) {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * This is the Thread function of a worker, which serves connections from the work queue.
+ *
+ * Parameters:
+ *   arg: Unused Argument
+ *
+ * Returns:
+ *   NULL
+ */
+static void *worker_thread(void *arg)
+{
+    (void)arg; // Unused
+    struct connection *conn;
+
+    while ((conn = queue_pop()) != NULL) {
+        serve_connection(conn);
+    }
+    return NULL;
+}
+
+int event_loop_start(int num_loops, int num_workers)
+{
+    struct epoll_event ev;
+    sigset_t block_set, old_set;
+
+    loops = calloc(num_loops, sizeof(*loops));
+    workers = calloc(num_workers, sizeof(*workers));
+    if (!loops || !workers) {
+        syslog(LOG_ERR, "Failed to allocate memory for event loop threads");
+        goto fail;
+    }
+
+    wakeup_fd = eventfd(0, EFD_NONBLOCK);
+    if (wakeup_fd == -1) {
+        syslog(LOG_ERR, "Failed to create eventfd: %s", strerror(errno));
+        goto fail;
+    }
+
+    /* Only the main thread should handle termination signals */
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    sigaddset(&block_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+
+    for (loop_count = 0; loop_count < num_loops; loop_count++) {
+        struct event_loop *loop = &loops[loop_count];
+        loop->epoll_fd = epoll_create1(0);
+        if (loop->epoll_fd == -1) {
+            syslog(LOG_ERR, "Failed to create epoll instance: %s", strerror(errno));
+            break;
+        }
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev) == -1 ||
+            pthread_create(&loop->thread_id, NULL, event_loop_thread, loop) != 0) {
+            syslog(LOG_ERR, "Failed to create event loop thread");
+            close(loop->epoll_fd);
+            break;
+        }
+    }
+
+    for (worker_count = 0; loop_count == num_loops && worker_count < num_workers; worker_count++) {
+        if (pthread_create(&workers[worker_count], NULL, worker_thread, NULL) != 0) {
+            syslog(LOG_ERR, "Failed to create worker thread");
+            break;
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if (loop_count != num_loops || worker_count != num_workers) {
+        event_loop_stop();
+        return -1;
+    }
+    syslog(LOG_INFO, "Started %d event loops and %d workers", num_loops, num_workers);
+    return 0;
+
+fail:
+    free(loops);
+    free(workers);
+    loops = NULL;
+    workers = NULL;
+    return -1;
+}
+
+int event_loop_add_client(int client_fd)
+{
+    struct epoll_event ev;
+    struct connection *conn;
+    int flags = fcntl(client_fd, F_GETFL, 0);
+
+    if (flags == -1 || fcntl(client_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        syslog(LOG_ERR, "Failed to make client socket non-blocking");
+        close(client_fd);
+        return -1;
+    }
+
+    conn = calloc(1, sizeof(*conn));
+    if (!conn) {
+        syslog(LOG_ERR, "Failed to allocate memory for connection");
+        close(client_fd);
+        return -1;
+    }
+    conn->client_fd = client_fd;
+    packet_buffer_init(&conn->pb);
+    pending_reply_init(&conn->reply);
+    conn->epoll_fd = loops[atomic_fetch_add(&next_loop, 1) % loop_count].epoll_fd;
+
+    pthread_mutex_lock(&connections_mutex);
+    LIST_INSERT_HEAD(&connections, conn, entries);
+    pthread_mutex_unlock(&connections_mutex);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(conn->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) == -1) {
+        syslog(LOG_ERR, "Failed to register client socket: %s", strerror(errno));
+        close_connection(conn);
+        return -1;
+    }
+    return 0;
+}
+
+void event_loop_stop(void)
+{
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&queue_mutex);
+    stopping = 1;
+    pthread_cond_broadcast(&queue_not_empty);
+    pthread_cond_broadcast(&queue_not_full);
+    pthread_mutex_unlock(&queue_mutex);
+
+    if (wakeup_fd != -1 && write(wakeup_fd, &one, sizeof(one)) == -1) {
+        syslog(LOG_ERR, "Failed to wake event loops");
+    }
+
+    for (int i = 0; i < loop_count; i++) {
+        pthread_join(loops[i].thread_id, NULL);
+    }
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    /* No thread owns a connection any more, release whatever is left */
+    pthread_mutex_lock(&connections_mutex);
+    while (!LIST_EMPTY(&connections)) {
+        struct connection *conn = LIST_FIRST(&connections);
+        LIST_REMOVE(conn, entries);
+        close(conn->client_fd);
+        stats_add(STATS_CONNECTIONS_CLOSED, 1);
+        packet_buffer_free(&conn->pb);
+        pending_reply_free(&conn->reply);
+        free(conn);
+    }
+    pthread_mutex_unlock(&connections_mutex);
+
+    for (int i = 0; i < loop_count; i++) {
+        close(loops[i].epoll_fd);
+    }
+    if (wakeup_fd != -1) {
+        close(wakeup_fd);
+        wakeup_fd = -1;
+    }
+    free(loops);
+    free(workers);
+    loops = NULL;
+    workers = NULL;
+    loop_count = 0;
+    worker_count = 0;
+}
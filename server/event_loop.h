@@ -0,0 +1,60 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    event_loop.h
+ * @brief   This header file declares the epoll event loop mode of aesdsocket, where a fixed
+ *          set of loop and worker threads serve all client connections.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+/*
+ * Starts the event loop threads and the worker pool.
+ *
+ * Parameters:
+ *   num_loops: Number of epoll loop threads owning client sockets
+ *   num_workers: Number of worker threads processing complete packets
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+int event_loop_start(int num_loops, int num_workers);
+
+/*
+ * Hands an accepted client socket over to one of the event loops.
+ *
+ * Parameters:
+ *   client_fd: The accepted client socket, owned by the event loop from here on
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1 (client_fd has been closed)
+ */
+int event_loop_add_client(int client_fd);
+
+/*
+ * Stops and joins all loop and worker threads and closes any remaining client sockets.
+ *
+ * Parameters:
+ *   None
+ *
+ * Returns:
+ *   None
+ */
+void event_loop_stop(void);
+
+#endif /* EVENT_LOOP_H */
@@ -0,0 +1,205 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    file_sink.c
+ * @brief   This file implements the file descriptor management for the aesdsocket data file.
+ *
+ * All writes and whole-file reads share one long-lived descriptor, using O_APPEND for writes
+ * and pread() for reads so no file position is shared. Requests which need their own file
+ * position borrow a descriptor from a small cache shared by all client threads.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "file_sink.h"
+
+static const char *sink_path;
+static atomic_int sink_fd = -1;
+static pthread_mutex_t sink_mutex = PTHREAD_MUTEX_INITIALIZER; // Protects opening and the reader cache
+
+static int reader_cache[FILE_SINK_READER_CACHE_SIZE];
+static int reader_count;
+
+static atomic_ulong open_count;
+static atomic_ulong close_count;
+
+/*
+ * Opens the data file and counts the call.
+ */
+static int sink_open(int flags)
+{
+    int fd = open(sink_path, flags | O_CLOEXEC, S_IRWXU | S_IRGRP | S_IROTH);
+    if (fd == -1) {
+        syslog(LOG_ERR, "Failed to open device file %s: %s", sink_path, strerror(errno));
+        return -1;
+    }
+    atomic_fetch_add(&open_count, 1);
+    return fd;
+}
+
+/*
+ * Closes a descriptor of the data file and counts the call.
+ */
+static void sink_close(int fd)
+{
+    close(fd);
+    atomic_fetch_add(&close_count, 1);
+}
+
+void file_sink_init(const char *path)
+{
+    sink_path = path;
+}
+
+int file_sink_fd(void)
+{
+    int fd = atomic_load(&sink_fd);
+
+    if (fd != -1) {
+        return fd;
+    }
+    pthread_mutex_lock(&sink_mutex);
+    fd = atomic_load(&sink_fd);
+    if (fd == -1) {
+        fd = sink_open(O_CREAT | O_APPEND | O_RDWR);
+        atomic_store(&sink_fd, fd);
+    }
+    pthread_mutex_unlock(&sink_mutex);
+    return fd;
+}
+
+int file_sink_write(const void *buf, size_t len)
+{
+    const char *ptr = (const char *)buf;
+    int fd = file_sink_fd();
+
+    if (fd == -1) {
+        return -1;
+    }
+    while (len > 0) {
+        ssize_t n = write(fd, ptr, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ptr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int file_sink_writev(struct iovec *iov, int iovcnt)
+{
+    int fd = file_sink_fd();
+
+    if (fd == -1) {
+        return -1;
+    }
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        /* Skip what was written and retry from the first incomplete buffer */
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+ssize_t file_sink_pread(void *buf, size_t len, off_t offset)
+{
+    int fd = file_sink_fd();
+    ssize_t n;
+
+    if (fd == -1) {
+        return -1;
+    }
+    do {
+        n = pread(fd, buf, len, offset);
+    } while (n == -1 && errno == EINTR);
+    return n;
+}
+
+int file_sink_get_reader(void)
+{
+    int fd = -1;
+
+    pthread_mutex_lock(&sink_mutex);
+    if (reader_count > 0) {
+        fd = reader_cache[--reader_count];
+    }
+    pthread_mutex_unlock(&sink_mutex);
+
+    /* Its previous user left it wherever its last read or seek ended */
+    if (fd != -1 && lseek(fd, 0, SEEK_SET) == -1) {
+        sink_close(fd);
+        fd = -1;
+    }
+    if (fd == -1) {
+        fd = sink_open(O_RDWR);
+    }
+    return fd;
+}
+
+void file_sink_put_reader(int fd)
+{
+    pthread_mutex_lock(&sink_mutex);
+    if (reader_count < FILE_SINK_READER_CACHE_SIZE) {
+        reader_cache[reader_count++] = fd;
+        fd = -1;
+    }
+    pthread_mutex_unlock(&sink_mutex);
+
+    if (fd != -1) {
+        sink_close(fd);
+    }
+}
+
+void file_sink_close(void)
+{
+    pthread_mutex_lock(&sink_mutex);
+    while (reader_count > 0) {
+        sink_close(reader_cache[--reader_count]);
+    }
+    int fd = atomic_exchange(&sink_fd, -1);
+    if (fd != -1) {
+        sink_close(fd);
+    }
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+void file_sink_get_stats(unsigned long *opens, unsigned long *closes)
+{
+    *opens = atomic_load(&open_count);
+    *closes = atomic_load(&close_count);
+}
@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    file_sink.h
+ * @brief   This header file declares the file descriptor management for the aesdsocket data
+ *          file, so steady state traffic needs no open() or close() calls.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef FILE_SINK_H
+#define FILE_SINK_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Maximum number of idle reader descriptors kept for reuse */
+#define FILE_SINK_READER_CACHE_SIZE 16
+
+/*
+ * Sets the path of the data file. Descriptors are opened lazily on first use, so the file
+ * or device does not have to exist yet.
+ */
+void file_sink_init(const char *path);
+
+/*
+ * Returns the long-lived descriptor of the data file, opening it on first use. It is opened
+ * for appending writes and positional reads, so its file position must not be relied upon.
+ *
+ * Returns:
+ *   On Success: The descriptor, owned by the sink
+ *   On Failure: -1
+ */
+int file_sink_fd(void);
+
+/*
+ * Appends len bytes to the data file through the long-lived descriptor. The caller must
+ * hold file_mutex.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+int file_sink_write(const void *buf, size_t len);
+
+/*
+ * Appends all iovcnt buffers to the data file with as few writev() calls as possible. The
+ * iov array is modified to track partial writes. The caller must hold file_mutex.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+int file_sink_writev(struct iovec *iov, int iovcnt);
+
+/*
+ * Reads from the data file at offset without using any file position.
+ *
+ * Returns:
+ *   Number of bytes read, 0 at EOF or -1 on error
+ */
+ssize_t file_sink_pread(void *buf, size_t len, off_t offset);
+
+/*
+ * Takes a descriptor with a private file position, for requests such as AESDCHAR_IOCSEEKTO
+ * which move the position. Idle descriptors are reused before a new one is opened, rewound to
+ * the start of the file, so the descriptor is always at offset 0 like a freshly opened one.
+ *
+ * Returns:
+ *   On Success: The descriptor, to be handed back with file_sink_put_reader()
+ *   On Failure: -1
+ */
+int file_sink_get_reader(void);
+
+/*
+ * Hands a descriptor from file_sink_get_reader() back for reuse.
+ */
+void file_sink_put_reader(int fd);
+
+/*
+ * Closes all descriptors held by the sink.
+ */
+void file_sink_close(void);
+
+/*
+ * Returns the number of open() and close() calls made on the data file so far.
+ */
+void file_sink_get_stats(unsigned long *opens, unsigned long *closes);
+
+#endif /* FILE_SINK_H */
@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    log_cache.c
+ * @brief   This file implements the in-memory copy of the aesdsocket data file.
+ *
+ * The cache state is protected by file_mutex, which every writer of the log already holds.
+ * Snapshots are reference counted so replies can be sent after file_mutex is released.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "file_sink.h"
+#include "log_cache.h"
+
+#define LOG_CACHE_MIN_CAPACITY 4096
+
+struct log_snapshot {
+    atomic_int refcount;
+    size_t cap;
+    char data[];
+};
+
+static struct log_snapshot *cache;  // NULL while the cache is invalid
+static size_t cache_len;
+static int cache_disabled;
+
+/*
+ * Allocates a snapshot buffer able to hold at least size bytes.
+ */
+static struct log_snapshot *snapshot_alloc(size_t size)
+{
+    size_t cap = LOG_CACHE_MIN_CAPACITY;
+    struct log_snapshot *snap;
+
+    while (cap < size) {
+        cap *= 2;
+    }
+    snap = malloc(sizeof(*snap) + cap);
+    if (snap) {
+        atomic_init(&snap->refcount, 1);
+        snap->cap = cap;
+    }
+    return snap;
+}
+
+/*
+ * Reads the whole data file into a new cache buffer.
+ */
+static int log_cache_fill(void)
+{
+    struct stat st;
+    size_t len = 0;
+    ssize_t n;
+    int fd = file_sink_fd();
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    /* Device files report no size, so start small and grow while reading */
+    if (fstat(fd, &st) == -1 || st.st_size > LOG_CACHE_MAX_SIZE) {
+        return -1;
+    }
+    struct log_snapshot *snap = snapshot_alloc(st.st_size);
+    if (!snap) {
+        return -1;
+    }
+
+    while ((n = file_sink_pread(snap->data + len, snap->cap - len, len)) > 0) {
+        len += n;
+        if (len == snap->cap) {
+            if (snap->cap * 2 > LOG_CACHE_MAX_SIZE) {
+                n = -1;
+                break;
+            }
+            struct log_snapshot *bigger = realloc(snap, sizeof(*snap) + snap->cap * 2);
+            if (!bigger) {
+                n = -1;
+                break;
+            }
+            snap = bigger;
+            snap->cap *= 2;
+        }
+    }
+
+    if (n < 0) {
+        free(snap);
+        return -1;
+    }
+    cache = snap;
+    cache_len = len;
+    return 0;
+}
+
+void log_cache_disable(void)
+{
+    cache_disabled = 1;
+}
+
+int log_cache_enabled(void)
+{
+    return !cache_disabled;
+}
+
+struct log_snapshot *log_cache_acquire(const char **data, size_t *len)
+{
+    if (cache_disabled) {
+        return NULL;
+    }
+    if (!cache && log_cache_fill() == -1) {
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&cache->refcount, 1, memory_order_relaxed);
+    *data = cache->data;
+    *len = cache_len;
+    return cache;
+}
+
+void log_cache_release(struct log_snapshot *snap)
+{
+    if (atomic_fetch_sub_explicit(&snap->refcount, 1, memory_order_acq_rel) == 1) {
+        free(snap);
+    }
+}
+
+void log_cache_append(const char *data, size_t len)
+{
+    if (!cache) {
+        return;
+    }
+    if (cache_len + len > LOG_CACHE_MAX_SIZE) {
+        log_cache_invalidate();
+        return;
+    }
+
+    if (cache_len + len > cache->cap) {
+        /* Outstanding references keep the old buffer alive until they are released */
+        struct log_snapshot *bigger = snapshot_alloc(cache_len + len);
+        if (!bigger) {
+            log_cache_invalidate();
+            return;
+        }
+        memcpy(bigger->data, cache->data, cache_len);
+        log_cache_release(cache);
+        cache = bigger;
+    }
+    memcpy(cache->data + cache_len, data, len);
+    cache_len += len;
+}
+
+void log_cache_invalidate(void)
+{
+    if (cache) {
+        log_cache_release(cache);
+        cache = NULL;
+        cache_len = 0;
+    }
+}
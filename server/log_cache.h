@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    log_cache.h
+ * @brief   This header file declares the in-memory copy of the aesdsocket data file which is
+ *          used to answer clients without reading the file back.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef LOG_CACHE_H
+#define LOG_CACHE_H
+
+#include <stddef.h>
+
+/* Largest log kept in memory, bigger logs are streamed from the file instead */
+#define LOG_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+/*
+ * Reference counted, append-only copy of the log. Appending never touches the first len
+ * bytes seen by an existing reference, so a reference stays valid without holding any lock.
+ */
+struct log_snapshot;
+
+/*
+ * Turns the cache off for a log which is not append-only. Must be called before any other
+ * log cache function.
+ */
+void log_cache_disable(void);
+
+/*
+ * Returns whether the cache is in use. While it is not, replies are streamed from the file
+ * without holding file_mutex.
+ */
+int log_cache_enabled(void);
+
+/*
+ * Returns a reference to the cached log, filling the cache from the data file if it is not
+ * valid. The caller must hold file_mutex and release the reference with log_cache_release().
+ *
+ * Parameters:
+ *   data: Set to the start of the cached log
+ *   len: Set to the length of the cached log
+ *
+ * Returns:
+ *   On Success: The snapshot reference
+ *   On Failure: NULL (the cache is disabled, or the log is too big or could not be read, stream
+ *               it from the file)
+ */
+struct log_snapshot *log_cache_acquire(const char **data, size_t *len);
+
+/*
+ * Drops a reference obtained from log_cache_acquire(). No lock needs to be held.
+ */
+void log_cache_release(struct log_snapshot *snap);
+
+/*
+ * Extends the cache with data just appended to the log. The caller must hold file_mutex.
+ */
+void log_cache_append(const char *data, size_t len);
+
+/*
+ * Drops the cached log, forcing the next log_cache_acquire() to re-read the file. Used when
+ * the log is not append-only. The caller must hold file_mutex.
+ */
+void log_cache_invalidate(void);
+
+#endif /* LOG_CACHE_H */
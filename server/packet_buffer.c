@@ -0,0 +1,110 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    packet_buffer.c
+ * @brief   This file implements the per-connection packet assembler of aesdsocket.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "packet_buffer.h"
+
+#define PACKET_BUFFER_MIN_CAPACITY 4096
+
+void packet_buffer_init(struct packet_buffer *pb)
+{
+    memset(pb, 0, sizeof(*pb));
+}
+
+void packet_buffer_free(struct packet_buffer *pb)
+{
+    free(pb->data);
+    packet_buffer_init(pb);
+}
+
+char *packet_buffer_reserve(struct packet_buffer *pb, size_t min_space, size_t *space)
+{
+    /* Move a pending partial packet to the front before considering a bigger buffer */
+    if (pb->head > 0) {
+        memmove(pb->data, pb->data + pb->head, pb->len - pb->head);
+        pb->len -= pb->head;
+        pb->scanned -= pb->head;
+        pb->head = 0;
+    }
+
+    if (pb->cap - pb->len < min_space) {
+        size_t new_cap = pb->cap ? pb->cap : PACKET_BUFFER_MIN_CAPACITY;
+        while (new_cap - pb->len < min_space) {
+            new_cap *= 2;
+        }
+        char *tmp = realloc(pb->data, new_cap);
+        if (!tmp) {
+            return NULL;
+        }
+        pb->data = tmp;
+        pb->cap = new_cap;
+    }
+
+    *space = pb->cap - pb->len;
+    return pb->data + pb->len;
+}
+
+void packet_buffer_commit(struct packet_buffer *pb, size_t n)
+{
+    pb->len += n;
+}
+
+/*
+ * Finds the newline ending the packet at head, remembering how far the search got.
+ */
+static char *find_newline(struct packet_buffer *pb)
+{
+    char *newline = NULL;
+
+    if (pb->len > pb->scanned) {
+        newline = memchr(pb->data + pb->scanned, '\n', pb->len - pb->scanned);
+    }
+    pb->scanned = newline ? (size_t)(newline - pb->data) : pb->len;
+    return newline;
+}
+
+int packet_buffer_next(struct packet_buffer *pb, const char **packet, size_t *len)
+{
+    char *newline = find_newline(pb);
+
+    if (!newline) {
+        return 0;
+    }
+    *packet = pb->data + pb->head;
+    *len = newline - *packet + 1;
+    pb->head += *len;
+    pb->scanned = pb->head;
+    return 1;
+}
+
+int packet_buffer_has_packet(struct packet_buffer *pb)
+{
+    return find_newline(pb) != NULL;
+}
+
+size_t packet_buffer_take_partial(struct packet_buffer *pb, const char **packet)
+{
+    size_t len = pb->len - pb->head;
+
+    *packet = pb->data + pb->head;
+    pb->head = pb->len;
+    pb->scanned = pb->len;
+    return len;
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    packet_buffer.h
+ * @brief   This header file declares the per-connection packet assembler, which collects
+ *          received bytes and splits them into newline terminated packets.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef PACKET_BUFFER_H
+#define PACKET_BUFFER_H
+
+#include <stddef.h>
+
+/*
+ * Growable receive buffer. Bytes in [head, len) have been received but not yet returned as
+ * a packet, and [head, scanned) is known to contain no newline so it is never searched twice.
+ */
+struct packet_buffer {
+    char *data;
+    size_t head;
+    size_t scanned;
+    size_t len;
+    size_t cap;
+};
+
+/*
+ * Initializes an empty packet buffer.
+ */
+void packet_buffer_init(struct packet_buffer *pb);
+
+/*
+ * Releases the memory held by a packet buffer.
+ */
+void packet_buffer_free(struct packet_buffer *pb);
+
+/*
+ * Returns space for at least min_space more received bytes, compacting or growing the
+ * buffer as needed. Packets returned by packet_buffer_next() are invalidated by this call.
+ *
+ * Parameters:
+ *   pb: The packet buffer
+ *   min_space: Minimum number of free bytes needed
+ *   space: Set to the number of free bytes available at the returned pointer
+ *
+ * Returns:
+ *   On Success: Pointer to the free space at the end of the buffer
+ *   On Failure: NULL (out of memory)
+ */
+char *packet_buffer_reserve(struct packet_buffer *pb, size_t min_space, size_t *space);
+
+/*
+ * Marks n bytes written to the space returned by packet_buffer_reserve() as received.
+ */
+void packet_buffer_commit(struct packet_buffer *pb, size_t n);
+
+/*
+ * Returns the next complete newline terminated packet and consumes it.
+ *
+ * Parameters:
+ *   pb: The packet buffer
+ *   packet: Set to the start of the packet, including the newline
+ *   len: Set to the length of the packet
+ *
+ * Returns:
+ *   1 if a packet was returned, 0 if no complete packet is buffered
+ */
+int packet_buffer_next(struct packet_buffer *pb, const char **packet, size_t *len);
+
+/*
+ * Returns whether a complete packet is buffered, without consuming it.
+ */
+int packet_buffer_has_packet(struct packet_buffer *pb);
+
+/*
+ * Returns the trailing bytes which are not newline terminated yet and consumes them. Used to
+ * flush a partial packet when the client disconnects.
+ *
+ * Returns:
+ *   Number of bytes returned in packet, 0 if nothing is pending
+ */
+size_t packet_buffer_take_partial(struct packet_buffer *pb, const char **packet);
+
+#endif /* PACKET_BUFFER_H */
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    pending_reply.c
+ * @brief   This file implements the per-connection reply backlog of aesdsocket.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include "pending_reply.h"
+#include "stats.h"
+
+#define PENDING_REPLY_MIN_CAPACITY 4096
+#define PENDING_REPLY_MAX (64 * 1024 * 1024)    // A client this far behind is dropped
+#define READ_CHUNK_SIZE 4096
+
+static __thread struct pending_reply *thread_target;
+
+void pending_reply_init(struct pending_reply *pr)
+{
+    memset(pr, 0, sizeof(*pr));
+}
+
+void pending_reply_free(struct pending_reply *pr)
+{
+    free(pr->data);
+    pending_reply_init(pr);
+}
+
+size_t pending_reply_size(const struct pending_reply *pr)
+{
+    return pr->len - pr->sent;
+}
+
+void pending_reply_set_target(struct pending_reply *pr)
+{
+    thread_target = pr;
+}
+
+struct pending_reply *pending_reply_target(void)
+{
+    return thread_target;
+}
+
+/*
+ * Returns space for at least min_space more bytes at the end of the backlog, dropping the bytes
+ * already sent and growing the buffer as needed.
+ *
+ * Returns:
+ *   On Success: Pointer to the free space
+ *   On Failure: NULL (out of memory or the backlog would exceed PENDING_REPLY_MAX)
+ */
+static char *reserve(struct pending_reply *pr, size_t min_space)
+{
+    if (pr->sent > 0) {
+        memmove(pr->data, pr->data + pr->sent, pr->len - pr->sent);
+        pr->len -= pr->sent;
+        pr->sent = 0;
+    }
+
+    if (min_space > PENDING_REPLY_MAX - pr->len) {
+        syslog(LOG_ERR, "Client is too far behind on replies, dropping it");
+        errno = ENOBUFS;
+        return NULL;
+    }
+    if (pr->cap - pr->len < min_space) {
+        size_t new_cap = pr->cap ? pr->cap : PENDING_REPLY_MIN_CAPACITY;
+        while (new_cap - pr->len < min_space) {
+            new_cap *= 2;
+        }
+        char *tmp = realloc(pr->data, new_cap);
+        if (!tmp) {
+            syslog(LOG_ERR, "Failed to grow reply backlog");
+            return NULL;
+        }
+        pr->data = tmp;
+        pr->cap = new_cap;
+    }
+    return pr->data + pr->len;
+}
+
+int pending_reply_append(struct pending_reply *pr, const void *buf, size_t len)
+{
+    char *dst = reserve(pr, len);
+
+    if (!dst) {
+        return -1;
+    }
+    memcpy(dst, buf, len);
+    pr->len += len;
+    return 0;
+}
+
+int pending_reply_append_fd(struct pending_reply *pr, int fd, off_t *offset, size_t max)
+{
+    while (max > 0) {
+        size_t chunk = max < READ_CHUNK_SIZE ? max : READ_CHUNK_SIZE;
+        char *dst = reserve(pr, chunk);
+        ssize_t n;
+
+        if (!dst) {
+            return -1;
+        }
+        n = offset ? pread(fd, dst, chunk, *offset) : read(fd, dst, chunk);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        pr->len += n;
+        max -= n;
+        if (offset) {
+            *offset += n;
+        }
+    }
+    return 0;
+}
+
+int pending_reply_flush(struct pending_reply *pr, int client_fd)
+{
+    while (pr->sent < pr->len) {
+        ssize_t n = send(client_fd, pr->data + pr->sent, pr->len - pr->sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            pr->sent += n;
+            stats_add(STATS_BYTES_OUT, n);
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    /* Replies can be as large as the whole log, don't keep the memory around */
+    pending_reply_free(pr);
+    return 1;
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    pending_reply.h
+ * @brief   This header file declares the per-connection reply backlog, which holds the part
+ *          of a reply a non-blocking client socket could not take yet.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef PENDING_REPLY_H
+#define PENDING_REPLY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Reply bytes waiting for the client socket to become writable. Bytes in [sent, len) have not
+ * been sent yet.
+ */
+struct pending_reply {
+    char *data;
+    size_t sent;
+    size_t len;
+    size_t cap;
+};
+
+/*
+ * Initializes an empty reply backlog.
+ */
+void pending_reply_init(struct pending_reply *pr);
+
+/*
+ * Releases the memory held by a reply backlog, dropping anything not sent yet.
+ */
+void pending_reply_free(struct pending_reply *pr);
+
+/*
+ * Returns the number of bytes waiting to be sent.
+ */
+size_t pending_reply_size(const struct pending_reply *pr);
+
+/*
+ * Makes pr the backlog of the calling thread, or clears it if pr is NULL. While a thread has a
+ * backlog, send_all() and the zero-copy engine append what the client socket cannot take right
+ * away to it instead of waiting for the socket to become writable.
+ */
+void pending_reply_set_target(struct pending_reply *pr);
+
+/*
+ * Returns the backlog of the calling thread, NULL if it has none.
+ */
+struct pending_reply *pending_reply_target(void);
+
+/*
+ * Appends bytes to a reply backlog.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1 (out of memory or the backlog would exceed its limit)
+ */
+int pending_reply_append(struct pending_reply *pr, const void *buf, size_t len);
+
+/*
+ * Appends up to max bytes read from a file to a reply backlog, stopping early at end of file.
+ *
+ * Parameters:
+ *   pr: The reply backlog
+ *   fd: The file to read from
+ *   offset: Offset to read from, advanced by the bytes read, or NULL to read from and advance
+ *           the file position
+ *   max: Maximum number of bytes to read
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1 (a read failed, out of memory or the backlog would exceed its limit)
+ */
+int pending_reply_append_fd(struct pending_reply *pr, int fd, off_t *offset, size_t max);
+
+/*
+ * Sends as much of a reply backlog as the non-blocking client socket takes.
+ *
+ * Returns:
+ *   1 if the backlog is empty now, 0 if the socket would block, -1 on failure
+ */
+int pending_reply_flush(struct pending_reply *pr, int client_fd);
+
+#endif /* PENDING_REPLY_H */
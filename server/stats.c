@@ -0,0 +1,215 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    stats.c
+ * @brief   This file implements the runtime statistics of aesdsocket.
+ *
+ * Every thread counts into a block of its own, so the hot path never writes a cache line
+ * shared with another thread. Blocks are linked into a list which is only walked when the
+ * statistics are read. When a thread exits its block is folded into the retired totals.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/queue.h>
+#include "stats.h"
+
+#define STATS_CACHE_LINE 64
+
+/* Structure to hold the counters of one thread */
+struct stats_block {
+    atomic_uint_fast64_t counters[STATS_COUNTER_MAX];
+    atomic_uint_fast64_t latency[STATS_LATENCY_BUCKETS];
+    LIST_ENTRY(stats_block) entries;
+} __attribute__((aligned(STATS_CACHE_LINE)));
+
+LIST_HEAD(stats_block_list, stats_block);
+
+static struct stats_block_list blocks = LIST_HEAD_INITIALIZER(blocks);
+static pthread_mutex_t blocks_mutex = PTHREAD_MUTEX_INITIALIZER; // Protects blocks and retired
+
+static struct stats_block retired;  // Totals of exited threads
+static struct stats_block shared;   // Used by threads which could not allocate a block
+
+static pthread_key_t block_key;
+static pthread_once_t block_key_once = PTHREAD_ONCE_INIT;
+static __thread struct stats_block *thread_block;
+
+/*
+ * Destructor of a thread's block, run when the owning thread exits.
+ */
+static void stats_block_retire(void *arg)
+{
+    struct stats_block *block = (struct stats_block *)arg;
+
+    pthread_mutex_lock(&blocks_mutex);
+    LIST_REMOVE(block, entries);
+    for (int i = 0; i < STATS_COUNTER_MAX; i++) {
+        atomic_fetch_add_explicit(&retired.counters[i], atomic_load(&block->counters[i]),
+                                  memory_order_relaxed);
+    }
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+        atomic_fetch_add_explicit(&retired.latency[i], atomic_load(&block->latency[i]),
+                                  memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&blocks_mutex);
+    free(block);
+
+    /* Later destructors of this thread may still count */
+    thread_block = &shared;
+}
+
+static void block_key_create(void)
+{
+    pthread_key_create(&block_key, stats_block_retire);
+}
+
+/*
+ * Returns the block of the calling thread, creating it on first use.
+ */
+static struct stats_block *get_block(void)
+{
+    struct stats_block *block = thread_block;
+
+    if (block) {
+        return block;
+    }
+    pthread_once(&block_key_once, block_key_create);
+    block = aligned_alloc(STATS_CACHE_LINE, sizeof(*block));
+    if (!block) {
+        return &shared;
+    }
+    memset(block, 0, sizeof(*block));
+
+    pthread_mutex_lock(&blocks_mutex);
+    LIST_INSERT_HEAD(&blocks, block, entries);
+    pthread_mutex_unlock(&blocks_mutex);
+    pthread_setspecific(block_key, block);
+    thread_block = block;
+    return block;
+}
+
+void stats_add(enum stats_counter counter, uint64_t n)
+{
+    atomic_fetch_add_explicit(&get_block()->counters[counter], n, memory_order_relaxed);
+}
+
+void stats_record_latency(uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+
+    /* Bucket b holds latencies below 2^b microseconds */
+    while (bucket < STATS_LATENCY_BUCKETS - 1 && us >= (1ULL << bucket)) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&get_block()->latency[bucket], 1, memory_order_relaxed);
+}
+
+uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void stats_mutex_lock(pthread_mutex_t *mutex)
+{
+    /* Only time the lock when it is contended */
+    if (pthread_mutex_trylock(mutex) != 0) {
+        uint64_t start = stats_now_ns();
+        pthread_mutex_lock(mutex);
+        stats_add(STATS_LOCK_WAIT_NS, stats_now_ns() - start);
+    }
+    stats_add(STATS_LOCK_ACQUISITIONS, 1);
+}
+
+/*
+ * Adds the counters of one block to the totals.
+ */
+static void sum_block(struct stats_block *block, uint64_t *counters, uint64_t *latency)
+{
+    for (int i = 0; i < STATS_COUNTER_MAX; i++) {
+        counters[i] += atomic_load_explicit(&block->counters[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+        latency[i] += atomic_load_explicit(&block->latency[i], memory_order_relaxed);
+    }
+}
+
+size_t stats_format(char *buf, size_t size)
+{
+    uint64_t counters[STATS_COUNTER_MAX] = { 0 };
+    uint64_t latency[STATS_LATENCY_BUCKETS] = { 0 };
+    struct stats_block *block;
+    size_t len = 0;
+    int n;
+
+    pthread_mutex_lock(&blocks_mutex);
+    LIST_FOREACH(block, &blocks, entries) {
+        sum_block(block, counters, latency);
+    }
+    sum_block(&retired, counters, latency);
+    pthread_mutex_unlock(&blocks_mutex);
+    sum_block(&shared, counters, latency);
+
+    n = snprintf(buf, size,
+                 "connections_accepted %llu\n"
+                 "connections_active %llu\n"
+                 "packets %llu\n"
+                 "bytes_in %llu\n"
+                 "bytes_written %llu\n"
+                 "bytes_out %llu\n"
+                 "replies %llu\n"
+                 "lock_acquisitions %llu\n"
+                 "lock_wait_us %llu\n",
+                 (unsigned long long)counters[STATS_CONNECTIONS_ACCEPTED],
+                 (unsigned long long)(counters[STATS_CONNECTIONS_ACCEPTED] -
+                                      counters[STATS_CONNECTIONS_CLOSED]),
+                 (unsigned long long)counters[STATS_PACKETS],
+                 (unsigned long long)counters[STATS_BYTES_IN],
+                 (unsigned long long)counters[STATS_BYTES_WRITTEN],
+                 (unsigned long long)counters[STATS_BYTES_OUT],
+                 (unsigned long long)counters[STATS_REPLIES],
+                 (unsigned long long)counters[STATS_LOCK_ACQUISITIONS],
+                 (unsigned long long)(counters[STATS_LOCK_WAIT_NS] / 1000));
+    if (n < 0) {
+        return 0;
+    }
+    len = (size_t)n < size ? (size_t)n : size - 1;
+
+    /* Histogram lines, one per bucket up to the last one in use */
+    int last = STATS_LATENCY_BUCKETS - 1;
+    while (last > 0 && latency[last] == 0) {
+        last--;
+    }
+    for (int i = 0; i <= last && len < size - 1; i++) {
+        if (i == STATS_LATENCY_BUCKETS - 1) {
+            n = snprintf(buf + len, size - len, "packet_latency_us_inf %llu\n",
+                         (unsigned long long)latency[i]);
+        } else {
+            n = snprintf(buf + len, size - len, "packet_latency_us_lt_%llu %llu\n",
+                         1ULL << i, (unsigned long long)latency[i]);
+        }
+        if (n < 0) {
+            break;
+        }
+        len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+    }
+    return len;
+}
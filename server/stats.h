@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    stats.h
+ * @brief   This header file declares the runtime statistics of aesdsocket, which clients can
+ *          query with the AESDSOCKET_STATS command.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Packet latencies are counted in power of two microsecond buckets up to about 8 seconds */
+#define STATS_LATENCY_BUCKETS 24
+
+/* Counters kept by every thread and summed when the statistics are read */
+enum stats_counter {
+    STATS_CONNECTIONS_ACCEPTED,
+    STATS_CONNECTIONS_CLOSED,
+    STATS_PACKETS,
+    STATS_BYTES_IN,             // Received from clients
+    STATS_BYTES_WRITTEN,        // Written to the data file
+    STATS_BYTES_OUT,            // Sent to clients
+    STATS_REPLIES,
+    STATS_LOCK_ACQUISITIONS,    // Acquisitions of file_mutex
+    STATS_LOCK_WAIT_NS,         // Time spent waiting for file_mutex
+    STATS_COUNTER_MAX
+};
+
+/*
+ * Adds n to a counter of the calling thread.
+ */
+void stats_add(enum stats_counter counter, uint64_t n);
+
+/*
+ * Counts one packet handled in the given time in the latency histogram of the calling thread.
+ */
+void stats_record_latency(uint64_t ns);
+
+/*
+ * Returns the current monotonic time in nanoseconds.
+ */
+uint64_t stats_now_ns(void);
+
+/*
+ * Locks mutex, counting the acquisition and the time spent waiting for it.
+ */
+void stats_mutex_lock(pthread_mutex_t *mutex);
+
+/*
+ * Writes the statistics of all threads, merged, as "name value" lines.
+ *
+ * Parameters:
+ *   buf: Buffer to format into
+ *   size: Size of buf
+ *
+ * Returns:
+ *   Length of the text, truncated to fit buf
+ */
+size_t stats_format(char *buf, size_t size);
+
+#endif /* STATS_H */
@@ -0,0 +1,607 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    uring_loop.c
+ * @brief   This file implements the io_uring engine of aesdsocket.
+ *
+ * One thread owns a ring and keeps an accept, and per connection either a receive or a reply
+ * send, in flight. Complete packets of all connections are gathered and written to the data
+ * file with a single writev in submission order, through a registered file descriptor, while
+ * file_mutex is held. When the write completes every packet is answered from the log cache,
+ * which is read back while the file is still quiescent, or streamed from the file when the cache
+ * is disabled. Each loop iteration submits all new requests and reaps all completions with one
+ * io_uring_enter() call.
+ *
+ * Commands (AESDCHAR_IOCSEEKTO, AESDSOCKET_STATS) are rare and go through the regular
+ * process_packet() path on the ring thread.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifdef HAVE_LIBURING
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <liburing.h>
+#include "aesdsocket.h"
+#include "file_sink.h"
+#include "log_cache.h"
+#include "packet_buffer.h"
+#include "stats.h"
+#include "uring_loop.h"
+
+#define URING_QUEUE_DEPTH 256
+#define URING_RECV_SIZE 4096
+#define URING_MAX_BATCH 64          // Most packets gathered into one writev
+#define URING_WAIT_MS 1000          // How often an idle loop checks for termination
+#define URING_DRAIN_TRIES 5         // Waits for cancelled requests before giving up on shutdown
+
+enum uring_op_type {
+    URING_OP_ACCEPT,
+    URING_OP_RECV,
+    URING_OP_WRITE,
+    URING_OP_SEND,
+};
+
+struct uring_conn;
+
+/* Structure to hold one request in flight, used as its user_data */
+struct uring_op {
+    enum uring_op_type type;
+    struct uring_conn *conn;    // NULL for accept and write
+    int busy;
+};
+
+/* Structure to hold the state of one client connection */
+struct uring_conn {
+    int client_fd;
+    struct packet_buffer pb;
+    int eof;                    // Peer closed the connection or a socket error was seen
+    struct uring_op recv_op;
+    struct uring_op send_op;
+
+    /* The data packet being handled */
+    const char *packet;
+    size_t packet_len;
+    uint64_t packet_start;
+    int queued;                 // Waiting for or part of a writev
+    struct log_snapshot *snap;  // Reply being sent
+    const char *reply;
+    size_t reply_len;
+    size_t reply_sent;
+
+    LIST_ENTRY(uring_conn) entries;
+    TAILQ_ENTRY(uring_conn) write_entries;
+};
+
+LIST_HEAD(uring_conn_list, uring_conn);
+TAILQ_HEAD(uring_write_queue, uring_conn);
+
+/* Structure to hold the state of one ring and its thread */
+struct uring_loop {
+    struct io_uring ring;
+    int listen_fd;
+    struct uring_op accept_op;
+    struct sockaddr_storage client_addr;
+    socklen_t addr_len;
+
+    int file_fd;                // Descriptor or registered file index of the data file
+    int fixed_file;
+
+    struct uring_op write_op;
+    struct uring_write_queue write_queue;           // Packets waiting for the next writev
+    struct uring_conn *batch[URING_MAX_BATCH];     // Packets of the writev in flight
+    struct iovec iov[URING_MAX_BATCH];
+    int batch_count;
+    int batch_done;             // Packets of the batch completely written so far
+
+    struct uring_conn_list conns;
+};
+
+static void serve_conn(struct uring_loop *loop, struct uring_conn *conn);
+
+/*
+ * Returns a free submission queue entry, submitting queued entries to make room if needed.
+ */
+static struct io_uring_sqe *get_sqe(struct uring_loop *loop)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&loop->ring);
+
+    if (!sqe) {
+        io_uring_submit(&loop->ring);
+        sqe = io_uring_get_sqe(&loop->ring);
+    }
+    return sqe;
+}
+
+static void arm_accept(struct uring_loop *loop)
+{
+    struct io_uring_sqe *sqe = get_sqe(loop);
+
+    if (!sqe) {
+        return;
+    }
+    loop->addr_len = sizeof(loop->client_addr);
+    io_uring_prep_accept(sqe, loop->listen_fd, (struct sockaddr *)&loop->client_addr,
+                         &loop->addr_len, 0);
+    io_uring_sqe_set_data(sqe, &loop->accept_op);
+    loop->accept_op.busy = 1;
+}
+
+/*
+ * Closes the client socket of a connection and releases it. The connection must not have a
+ * request in flight.
+ */
+static void close_conn(struct uring_conn *conn)
+{
+    LIST_REMOVE(conn, entries);
+    close(conn->client_fd);
+    stats_add(STATS_CONNECTIONS_CLOSED, 1);
+    if (conn->snap) {
+        log_cache_release(conn->snap);
+    }
+    packet_buffer_free(&conn->pb);
+    free(conn);
+}
+
+static void arm_recv(struct uring_loop *loop, struct uring_conn *conn)
+{
+    struct io_uring_sqe *sqe;
+    size_t space;
+    char *recv_ptr = packet_buffer_reserve(&conn->pb, URING_RECV_SIZE, &space);
+
+    if (!recv_ptr) {
+        syslog(LOG_ERR, "Failed to grow packet buffer");
+        close_conn(conn);
+        return;
+    }
+    sqe = get_sqe(loop);
+    if (!sqe) {
+        close_conn(conn);
+        return;
+    }
+    io_uring_prep_recv(sqe, conn->client_fd, recv_ptr, space, 0);
+    io_uring_sqe_set_data(sqe, &conn->recv_op);
+    conn->recv_op.busy = 1;
+}
+
+/*
+ * Sends the rest of the reply of a connection.
+ */
+static void arm_send(struct uring_loop *loop, struct uring_conn *conn)
+{
+    struct io_uring_sqe *sqe = get_sqe(loop);
+
+    if (!sqe) {
+        close_conn(conn);
+        return;
+    }
+    io_uring_prep_send(sqe, conn->client_fd, conn->reply + conn->reply_sent,
+                       conn->reply_len - conn->reply_sent, MSG_NOSIGNAL);
+    io_uring_sqe_set_data(sqe, &conn->send_op);
+    conn->send_op.busy = 1;
+}
+
+/*
+ * Counts a finished data packet and carries on with the next one.
+ */
+static void finish_packet(struct uring_loop *loop, struct uring_conn *conn)
+{
+    stats_add(STATS_PACKETS, 1);
+    stats_record_latency(stats_now_ns() - conn->packet_start);
+    serve_conn(loop, conn);
+}
+
+/*
+ * Handles the buffered packets of a connection until one needs to be written, then queues it
+ * for the next writev. Receives more data or closes the connection once nothing is left.
+ */
+static void serve_conn(struct uring_loop *loop, struct uring_conn *conn)
+{
+    const char *packet;
+    size_t len = 0;
+
+    while (packet_buffer_next(&conn->pb, &packet, &len)) {
+        if (!packet_is_command(packet, len)) {
+            break;
+        }
+        if (process_packet(conn->client_fd, packet, len) == -1) {
+            close_conn(conn);
+            return;
+        }
+        len = 0;
+    }
+
+    /* Data without a trailing newline is still handled once the client disconnects */
+    if (len == 0 && conn->eof) {
+        len = packet_buffer_take_partial(&conn->pb, &packet);
+        if (len > 0 && packet_is_command(packet, len)) {
+            process_packet(conn->client_fd, packet, len);
+            len = 0;
+        }
+    }
+
+    if (len > 0) {
+        conn->packet = packet;
+        conn->packet_len = len;
+        conn->packet_start = stats_now_ns();
+        conn->queued = 1;
+        TAILQ_INSERT_TAIL(&loop->write_queue, conn, write_entries);
+    } else if (conn->eof) {
+        close_conn(conn);
+    } else {
+        arm_recv(loop, conn);
+    }
+}
+
+/*
+ * Submits a writev of the packets of the batch not completely written yet.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1 (the submission queue is full, flush_writes() tries again)
+ */
+static int submit_batch(struct uring_loop *loop)
+{
+    struct io_uring_sqe *sqe = get_sqe(loop);
+    int i = loop->batch_done;
+
+    if (!sqe) {
+        return -1;
+    }
+    io_uring_prep_writev(sqe, loop->file_fd, &loop->iov[i], loop->batch_count - i, -1);
+    if (loop->fixed_file) {
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    }
+    io_uring_sqe_set_data(sqe, &loop->write_op);
+    loop->write_op.busy = 1;
+    return 0;
+}
+
+/*
+ * Submits the queued packets of all connections as one writev, unless one is already in
+ * flight, or resumes the batch whose rest could not be submitted yet.
+ *
+ * file_mutex is held from the submission until the whole batch is written, a full round trip
+ * of the ring, which other writers of the log wait for. The log cache must see the packets in
+ * the order they reach the file, and the rest of a partial write must follow it before any
+ * other writer appends.
+ */
+static void flush_writes(struct uring_loop *loop)
+{
+    if (loop->write_op.busy) {
+        return;
+    }
+    if (loop->batch_count > 0) {
+        submit_batch(loop);
+        return;
+    }
+    if (TAILQ_EMPTY(&loop->write_queue)) {
+        return;
+    }
+
+    loop->batch_count = 0;
+    loop->batch_done = 0;
+    while (!TAILQ_EMPTY(&loop->write_queue) && loop->batch_count < URING_MAX_BATCH) {
+        struct uring_conn *conn = TAILQ_FIRST(&loop->write_queue);
+        TAILQ_REMOVE(&loop->write_queue, conn, write_entries);
+        loop->batch[loop->batch_count] = conn;
+        loop->iov[loop->batch_count].iov_base = (void *)conn->packet;
+        loop->iov[loop->batch_count].iov_len = conn->packet_len;
+        loop->batch_count++;
+    }
+
+    stats_mutex_lock(&file_mutex);
+    submit_batch(loop);
+}
+
+/*
+ * Handles the completion of the writev in flight. Partial writes are resumed, on the next loop
+ * iteration if the submission queue is full, otherwise every packet of the batch is recorded in
+ * the log cache and answered.
+ */
+static void on_write(struct uring_loop *loop, int res)
+{
+    int i = loop->batch_done;
+
+    loop->write_op.busy = 0;
+    if (res > 0) {
+        stats_add(STATS_BYTES_WRITTEN, res);
+        while (i < loop->batch_count && (size_t)res >= loop->iov[i].iov_len) {
+            res -= loop->iov[i].iov_len;
+            log_written(loop->batch[i]->packet, loop->batch[i]->packet_len);
+            i++;
+        }
+        loop->batch_done = i;
+        if (i < loop->batch_count) {
+            /* Resume within the first incomplete packet, nothing failed */
+            loop->iov[i].iov_base = (char *)loop->iov[i].iov_base + res;
+            loop->iov[i].iov_len -= res;
+            submit_batch(loop);
+            return;
+        }
+    }
+
+    if (loop->batch_done < loop->batch_count) {
+        syslog(LOG_ERR, "Failed to write to file: %s", strerror(res < 0 ? -res : EIO));
+        /* It is unknown how much of the batch made it to the file */
+        log_cache_invalidate();
+        pthread_mutex_unlock(&file_mutex);
+        for (i = 0; i < loop->batch_count; i++) {
+            loop->batch[i]->queued = 0;
+            close_conn(loop->batch[i]);
+        }
+        loop->batch_count = 0;
+        return;
+    }
+
+    /* Take the replies while the file cannot change, unless they are streamed from it */
+    for (i = 0; i < loop->batch_count; i++) {
+        struct uring_conn *conn = loop->batch[i];
+        conn->snap = NULL;
+        if (log_cache_enabled() && conn->packet[conn->packet_len - 1] == '\n') {
+            conn->snap = log_cache_acquire(&conn->reply, &conn->reply_len);
+        }
+    }
+    pthread_mutex_unlock(&file_mutex);
+
+    for (i = 0; i < loop->batch_count; i++) {
+        struct uring_conn *conn = loop->batch[i];
+        conn->queued = 0;
+        if (conn->packet[conn->packet_len - 1] != '\n') {
+            finish_packet(loop, conn);
+        } else if (conn->snap) {
+            stats_add(STATS_REPLIES, 1);
+            conn->reply_sent = 0;
+            arm_send(loop, conn);
+        } else if (send_log(conn->client_fd) == -1) {
+            /* The log is not cached, so it was streamed from the file */
+            close_conn(conn);
+        } else {
+            finish_packet(loop, conn);
+        }
+    }
+    loop->batch_count = 0;
+}
+
+static void on_send(struct uring_loop *loop, struct uring_conn *conn, int res)
+{
+    conn->send_op.busy = 0;
+    if (res <= 0) {
+        close_conn(conn);
+        return;
+    }
+    stats_add(STATS_BYTES_OUT, res);
+    conn->reply_sent += res;
+    if (conn->reply_sent < conn->reply_len) {
+        arm_send(loop, conn);
+        return;
+    }
+    log_cache_release(conn->snap);
+    conn->snap = NULL;
+    finish_packet(loop, conn);
+}
+
+static void on_recv(struct uring_loop *loop, struct uring_conn *conn, int res)
+{
+    conn->recv_op.busy = 0;
+    if (res > 0) {
+        stats_add(STATS_BYTES_IN, res);
+        packet_buffer_commit(&conn->pb, res);
+    } else if (res == -EINTR || res == -EAGAIN) {
+        arm_recv(loop, conn);
+        return;
+    } else {
+        conn->eof = 1;
+    }
+    serve_conn(loop, conn);
+}
+
+static void on_accept(struct uring_loop *loop, int res)
+{
+    struct uring_conn *conn;
+
+    loop->accept_op.busy = 0;
+    if (!terminate_program) {
+        arm_accept(loop);
+    }
+    if (res < 0) {
+        if (!terminate_program) {
+            syslog(LOG_ERR, "Accept failed: %s", strerror(-res));
+        }
+        return;
+    }
+
+    stats_add(STATS_CONNECTIONS_ACCEPTED, 1);
+    struct sockaddr_in *client_in = (struct sockaddr_in *)&loop->client_addr;
+    syslog(LOG_INFO, "Accepted connection from %s", inet_ntoa(client_in->sin_addr));
+
+    /* Commands reply with send_all(), which must not block the whole ring */
+    int flags = fcntl(res, F_GETFL, 0);
+    conn = calloc(1, sizeof(*conn));
+    if (flags == -1 || fcntl(res, F_SETFL, flags | O_NONBLOCK) == -1 || !conn) {
+        syslog(LOG_ERR, "Failed to set up connection");
+        free(conn);
+        close(res);
+        stats_add(STATS_CONNECTIONS_CLOSED, 1);
+        return;
+    }
+    conn->client_fd = res;
+    packet_buffer_init(&conn->pb);
+    conn->recv_op.type = URING_OP_RECV;
+    conn->recv_op.conn = conn;
+    conn->send_op.type = URING_OP_SEND;
+    conn->send_op.conn = conn;
+    LIST_INSERT_HEAD(&loop->conns, conn, entries);
+    arm_recv(loop, conn);
+}
+
+/*
+ * Dispatches one completion to its handler.
+ */
+static void handle_cqe(struct uring_loop *loop, struct io_uring_cqe *cqe)
+{
+    struct uring_op *op = io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+
+    if (!op) {
+        return; // Cancel request
+    }
+    switch (op->type) {
+    case URING_OP_ACCEPT:
+        on_accept(loop, res);
+        break;
+    case URING_OP_RECV:
+        on_recv(loop, op->conn, res);
+        break;
+    case URING_OP_WRITE:
+        on_write(loop, res);
+        break;
+    case URING_OP_SEND:
+        on_send(loop, op->conn, res);
+        break;
+    }
+}
+
+/*
+ * Submits everything queued, waits for at least one completion and handles all available.
+ */
+static void run_once(struct uring_loop *loop)
+{
+    struct __kernel_timespec ts = { .tv_sec = URING_WAIT_MS / 1000,
+                                    .tv_nsec = (URING_WAIT_MS % 1000) * 1000000L };
+    struct io_uring_cqe *cqe;
+
+    flush_writes(loop);
+    io_uring_submit(&loop->ring);
+    if (io_uring_wait_cqe_timeout(&loop->ring, &cqe, &ts) != 0) {
+        return; // Timeout or signal
+    }
+    while (io_uring_peek_cqe(&loop->ring, &cqe) == 0) {
+        handle_cqe(loop, cqe);
+        io_uring_cqe_seen(&loop->ring, cqe);
+    }
+}
+
+/*
+ * Returns whether any request referencing loop or connection memory is still in flight, or a
+ * batch is still waiting to be resumed.
+ */
+static int requests_in_flight(struct uring_loop *loop)
+{
+    struct uring_conn *conn;
+
+    if (loop->accept_op.busy || loop->write_op.busy || loop->batch_count > 0) {
+        return 1;
+    }
+    LIST_FOREACH(conn, &loop->conns, entries) {
+        if (conn->recv_op.busy || conn->send_op.busy) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Cancels a request in flight.
+ */
+static void cancel_op(struct uring_loop *loop, struct uring_op *op)
+{
+    struct io_uring_sqe *sqe;
+
+    if (!op->busy || !(sqe = get_sqe(loop))) {
+        return;
+    }
+    io_uring_prep_cancel(sqe, op, 0);
+    io_uring_sqe_set_data(sqe, NULL);
+}
+
+/*
+ * Cancels all requests and releases all connections once the kernel no longer uses them.
+ */
+static void shutdown_loop(struct uring_loop *loop)
+{
+    struct uring_conn *conn;
+    int tries;
+
+    cancel_op(loop, &loop->accept_op);
+    LIST_FOREACH(conn, &loop->conns, entries) {
+        cancel_op(loop, &conn->recv_op);
+        cancel_op(loop, &conn->send_op);
+    }
+    for (tries = 0; requests_in_flight(loop) && tries < URING_DRAIN_TRIES; tries++) {
+        run_once(loop);
+    }
+    if (requests_in_flight(loop)) {
+        /* Freeing memory the kernel may still write to is worse than leaking it */
+        syslog(LOG_ERR, "io_uring requests still in flight on exit");
+        return;
+    }
+
+    TAILQ_INIT(&loop->write_queue);
+    while (!LIST_EMPTY(&loop->conns)) {
+        close_conn(LIST_FIRST(&loop->conns));
+    }
+    io_uring_queue_exit(&loop->ring);
+}
+
+int uring_loop_run(int listen_fd)
+{
+    struct uring_loop *loop = calloc(1, sizeof(*loop));
+    int ret;
+
+    if (!loop) {
+        return -1;
+    }
+    ret = io_uring_queue_init(URING_QUEUE_DEPTH, &loop->ring, 0);
+    if (ret < 0) {
+        syslog(LOG_ERR, "Failed to set up io_uring: %s", strerror(-ret));
+        free(loop);
+        return -1;
+    }
+
+    loop->listen_fd = listen_fd;
+    loop->accept_op.type = URING_OP_ACCEPT;
+    loop->write_op.type = URING_OP_WRITE;
+    TAILQ_INIT(&loop->write_queue);
+    LIST_INIT(&loop->conns);
+
+    /* Writes go through a registered file, saving the descriptor lookup per request */
+    loop->file_fd = file_sink_fd();
+    if (loop->file_fd != -1 && io_uring_register_files(&loop->ring, &loop->file_fd, 1) == 0) {
+        loop->file_fd = 0;
+        loop->fixed_file = 1;
+    }
+
+    syslog(LOG_INFO, "Serving clients from io_uring%s",
+           loop->fixed_file ? " with a registered data file" : "");
+    arm_accept(loop);
+    while (!terminate_program) {
+        run_once(loop);
+    }
+
+    shutdown_loop(loop);
+    if (!requests_in_flight(loop)) {
+        free(loop);
+    }
+    return 0;
+}
+
+#endif /* HAVE_LIBURING */
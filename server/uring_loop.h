@@ -0,0 +1,41 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    uring_loop.h
+ * @brief   This header file declares the io_uring engine of aesdsocket, which is only built
+ *          when liburing is available (HAVE_LIBURING).
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef URING_LOOP_H
+#define URING_LOOP_H
+
+#ifdef HAVE_LIBURING
+
+/*
+ * Accepts and serves clients of a listening socket from an io_uring owned by the calling
+ * thread until the program terminates.
+ *
+ * Parameters:
+ *   listen_fd: The listening socket
+ *
+ * Returns:
+ *   0 once the program terminates, or -1 if the ring could not be set up (for example on a
+ *   kernel without io_uring), in which case the caller should serve listen_fd itself
+ */
+int uring_loop_run(int listen_fd);
+
+#endif /* HAVE_LIBURING */
+
+#endif /* URING_LOOP_H */
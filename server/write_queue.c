@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    write_queue.c
+ * @brief   This file implements the group commit writer of aesdsocket.
+ *
+ * Submitting threads push a request living on their own stack onto a lock-free stack with a
+ * single compare-and-swap. The writer thread takes the whole stack with one exchange,
+ * reverses it into submission order and commits it with a single writev(), so any number of
+ * packets queued while the previous commit was running cost one lock and one system call.
+ * The writer is only woken when a push finds the stack empty.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include "write_queue.h"
+
+/* Structure to hold one queued packet, owned by the submitting thread */
+struct write_request {
+    const char *data;
+    size_t len;
+    int status;
+    sem_t done;                 // Posted by the writer once the packet is committed
+    struct write_request *next;
+};
+
+static _Atomic(struct write_request *) queue_head;
+static sem_t writer_wakeup;
+static pthread_t writer_thread_id;
+static write_queue_commit_fn commit_batch;
+static atomic_int stopping;
+
+static atomic_ulong packet_count;
+static atomic_ulong commit_count;
+
+/*
+ * Commits up to WRITE_QUEUE_MAX_BATCH requests starting at req and completes them.
+ *
+ * Returns:
+ *   The first request which was not part of this batch, or NULL
+ */
+static struct write_request *commit_requests(struct write_request *req)
+{
+    struct iovec iov[WRITE_QUEUE_MAX_BATCH];
+    struct write_request *first = req;
+    int count = 0;
+    int status;
+
+    for (; req && count < WRITE_QUEUE_MAX_BATCH; req = req->next) {
+        iov[count].iov_base = (void *)req->data;
+        iov[count].iov_len = req->len;
+        count++;
+    }
+    status = commit_batch(iov, count);
+    atomic_fetch_add(&packet_count, count);
+    atomic_fetch_add(&commit_count, 1);
+
+    /* A request may go away as soon as it is posted, so read next first */
+    while (first != req) {
+        struct write_request *next = first->next;
+        first->status = status;
+        sem_post(&first->done);
+        first = next;
+    }
+    return req;
+}
+
+/*
+ * This is the Thread function of the writer, which commits queued packets in batches until
+ * the queue is stopped and empty.
+ *
+ * Parameters:
+ *   arg: Unused Argument
+ *
+ * Returns:
+ *   NULL
+ */
+static void *writer_thread(void *arg)
+{
+    (void)arg; // Unused
+
+    while (1) {
+        struct write_request *batch = atomic_exchange_explicit(&queue_head, NULL,
+                                                               memory_order_acquire);
+        if (!batch) {
+            if (atomic_load(&stopping)) {
+                break;
+            }
+            while (sem_wait(&writer_wakeup) == -1 && errno == EINTR);
+            continue;
+        }
+
+        /* The stack is newest first, reverse it so packets are written in order */
+        struct write_request *ordered = NULL;
+        while (batch) {
+            struct write_request *next = batch->next;
+            batch->next = ordered;
+            ordered = batch;
+            batch = next;
+        }
+        while (ordered) {
+            ordered = commit_requests(ordered);
+        }
+    }
+    return NULL;
+}
+
+int write_queue_start(write_queue_commit_fn commit)
+{
+    sigset_t block_set, old_set;
+    int ret;
+
+    commit_batch = commit;
+    atomic_store(&stopping, 0);
+    if (sem_init(&writer_wakeup, 0, 0) == -1) {
+        syslog(LOG_ERR, "Failed to create writer semaphore: %s", strerror(errno));
+        return -1;
+    }
+
+    /* Only the main thread should handle termination signals */
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    sigaddset(&block_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+    ret = pthread_create(&writer_thread_id, NULL, writer_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if (ret != 0) {
+        syslog(LOG_ERR, "Failed to create writer thread");
+        sem_destroy(&writer_wakeup);
+        return -1;
+    }
+    return 0;
+}
+
+int write_queue_submit(const char *data, size_t len)
+{
+    struct write_request req;
+    struct write_request *head;
+    int cancel_state;
+
+    req.data = data;
+    req.len = len;
+    req.status = -1;
+    sem_init(&req.done, 0, 0);
+
+    /* The writer references req until it is posted, so the caller must not be cancelled */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+
+    head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+    do {
+        req.next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&queue_head, &head, &req,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+    if (head == NULL) {
+        sem_post(&writer_wakeup);
+    }
+
+    while (sem_wait(&req.done) == -1 && errno == EINTR);
+    sem_destroy(&req.done);
+
+    pthread_setcancelstate(cancel_state, NULL);
+    return req.status;
+}
+
+void write_queue_stop(void)
+{
+    atomic_store(&stopping, 1);
+    sem_post(&writer_wakeup);
+    pthread_join(writer_thread_id, NULL);
+    sem_destroy(&writer_wakeup);
+}
+
+void write_queue_get_stats(unsigned long *packets, unsigned long *commits)
+{
+    *packets = atomic_load(&packet_count);
+    *commits = atomic_load(&commit_count);
+}
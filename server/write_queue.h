@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    write_queue.h
+ * @brief   This header file declares the group commit writer of aesdsocket, where client
+ *          threads queue packets for a single writer thread instead of writing them directly.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef WRITE_QUEUE_H
+#define WRITE_QUEUE_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+/* Most packets written by a single commit */
+#define WRITE_QUEUE_MAX_BATCH 1024
+
+/*
+ * Writes a batch of packets in queue order, each packet being one buffer. Called from the
+ * writer thread only. The iov array may be modified.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1 (all packets of the batch are failed)
+ */
+typedef int (*write_queue_commit_fn)(struct iovec *iov, int iovcnt);
+
+/*
+ * Starts the writer thread.
+ *
+ * Parameters:
+ *   commit: Function writing each batch of queued packets
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+int write_queue_start(write_queue_commit_fn commit);
+
+/*
+ * Queues a packet for the writer thread and waits until it has been committed. The packet
+ * is not copied, so it only has to stay valid until this returns. Packets queued by one
+ * thread are committed in order, and a packet is never split by another one.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+int write_queue_submit(const char *data, size_t len);
+
+/*
+ * Commits all queued packets and stops the writer thread. No packet may be submitted once
+ * this has been called.
+ */
+void write_queue_stop(void);
+
+/*
+ * Returns the number of packets and commits made so far, to judge how well writes batch.
+ */
+void write_queue_get_stats(unsigned long *packets, unsigned long *commits);
+
+#endif /* WRITE_QUEUE_H */
@@ -0,0 +1,240 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    zerocopy.c
+ * @brief   This file implements the zero-copy reply engine of aesdsocket.
+ *
+ * Regular files are sent with sendfile(). Files without sendfile support are moved through
+ * a per-thread pipe with splice(), which still never copies the data into user memory. When the
+ * calling thread keeps a reply backlog and the client socket fills up, the rest of the file is
+ * copied to the backlog instead of waiting for the client.
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/sendfile.h>
+#include "aesdsocket.h"
+#include "zerocopy.h"
+#include "pending_reply.h"
+#include "stats.h"
+
+#define ZEROCOPY_CHUNK_SIZE (1024 * 1024)
+
+/* Structure to hold the pipe a thread splices through */
+struct splice_pipe {
+    int fds[2];
+};
+
+static pthread_key_t pipe_key;
+static pthread_once_t pipe_key_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Destructor of the per-thread pipe, run when the owning thread exits.
+ */
+static void splice_pipe_destroy(void *arg)
+{
+    struct splice_pipe *sp = (struct splice_pipe *)arg;
+    close(sp->fds[0]);
+    close(sp->fds[1]);
+    free(sp);
+}
+
+static void pipe_key_create(void)
+{
+    pthread_key_create(&pipe_key, splice_pipe_destroy);
+}
+
+/*
+ * Returns the pipe of the calling thread, creating it on first use.
+ */
+static struct splice_pipe *get_splice_pipe(void)
+{
+    struct splice_pipe *sp;
+
+    pthread_once(&pipe_key_once, pipe_key_create);
+    sp = pthread_getspecific(pipe_key);
+    if (sp) {
+        return sp;
+    }
+    sp = malloc(sizeof(*sp));
+    if (!sp) {
+        return NULL;
+    }
+    if (pipe2(sp->fds, O_CLOEXEC) == -1) {
+        syslog(LOG_ERR, "Failed to create splice pipe: %s", strerror(errno));
+        free(sp);
+        return NULL;
+    }
+    pthread_setspecific(pipe_key, sp);
+    return sp;
+}
+
+/*
+ * Sends the file with sendfile().
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1, errno is EINVAL if sendfile is not supported and nothing was sent
+ */
+static int send_with_sendfile(int client_fd, int file_fd, off_t *offset)
+{
+    struct pending_reply *pr = pending_reply_target();
+    size_t sent = 0;
+
+    while (1) {
+        ssize_t n = sendfile(client_fd, file_fd, offset, ZEROCOPY_CHUNK_SIZE);
+        if (n > 0) {
+            sent += n;
+            stats_add(STATS_BYTES_OUT, n);
+        } else if (n == 0) {
+            return 0;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (pr) {
+                return pending_reply_append_fd(pr, file_fd, offset, SIZE_MAX);
+            }
+            if (wait_writable(client_fd) == -1) {
+                return -1;
+            }
+        } else if (errno != EINTR) {
+            if ((errno == EINVAL || errno == ENOSYS) && sent > 0) {
+                errno = EIO;
+            }
+            return -1;
+        }
+    }
+}
+
+/*
+ * Appends the file from offset (or its position if offset is NULL) on to a reply backlog.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1
+ */
+static int defer_file(struct pending_reply *pr, int file_fd, loff_t *offset)
+{
+    off_t file_offset;
+    int ret;
+
+    if (!offset) {
+        return pending_reply_append_fd(pr, file_fd, NULL, SIZE_MAX);
+    }
+    file_offset = *offset;
+    ret = pending_reply_append_fd(pr, file_fd, &file_offset, SIZE_MAX);
+    *offset = file_offset;
+    return ret;
+}
+
+/*
+ * Sends the file by splicing it into a pipe and from the pipe into the socket.
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1, errno is EINVAL if splice is not supported and nothing was sent
+ */
+static int send_with_splice(int client_fd, int file_fd, loff_t *offset)
+{
+    struct splice_pipe *sp = get_splice_pipe();
+    struct pending_reply *pr = pending_reply_target();
+
+    if (!sp) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (1) {
+        ssize_t in = splice(file_fd, offset, sp->fds[1], NULL, ZEROCOPY_CHUNK_SIZE, SPLICE_F_MOVE);
+        if (in == 0) {
+            return 0;
+        }
+        if (in < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        /* Always drain the pipe completely so it is empty for the next reply */
+        while (in > 0) {
+            ssize_t out = splice(sp->fds[0], NULL, client_fd, NULL, in,
+                                 SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (out > 0) {
+                in -= out;
+                stats_add(STATS_BYTES_OUT, out);
+            } else if (out < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (pr) {
+                    /* Queue the rest for the event loop, starting with what the pipe holds */
+                    size_t queued = pending_reply_size(pr);
+                    int ret = pending_reply_append_fd(pr, sp->fds[0], NULL, in);
+                    in -= pending_reply_size(pr) - queued;
+                    if (ret == 0 && in == 0) {
+                        return defer_file(pr, file_fd, offset);
+                    }
+                    break;
+                }
+                if (wait_writable(client_fd) == -1) {
+                    break;
+                }
+            } else if (out == 0 || errno != EINTR) {
+                break;
+            }
+        }
+        if (in > 0) {
+            /* The client went away, discard what is left so the pipe can be reused */
+            char discard[4096];
+            while (in > 0) {
+                ssize_t n = read(sp->fds[0], discard, in < (ssize_t)sizeof(discard) ? in : (ssize_t)sizeof(discard));
+                if (n <= 0) {
+                    break;
+                }
+                in -= n;
+            }
+            errno = EPIPE;
+            return -1;
+        }
+    }
+}
+
+int zerocopy_send_file(int client_fd, int file_fd, off_t *offset)
+{
+    struct pending_reply *pr = pending_reply_target();
+    loff_t splice_offset;
+    int ret;
+
+    /* Replies must reach the client in order, so queue behind anything already waiting */
+    if (pr && pending_reply_size(pr) > 0) {
+        return pending_reply_append_fd(pr, file_fd, offset, SIZE_MAX);
+    }
+
+    if (send_with_sendfile(client_fd, file_fd, offset) == 0) {
+        return 0;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        return -1;
+    }
+    if (!offset) {
+        return send_with_splice(client_fd, file_fd, NULL);
+    }
+    splice_offset = *offset;
+    ret = send_with_splice(client_fd, file_fd, &splice_offset);
+    *offset = splice_offset;
+    return ret;
+}
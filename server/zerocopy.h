@@ -0,0 +1,45 @@
+/*******************************************************************************
+ * Copyright (C) 2025 by Abhirath Koushik
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Abhirath Koushik and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    zerocopy.h
+ * @brief   This header file declares the zero-copy reply engine of aesdsocket, which moves
+ *          file data to a client socket inside the kernel.
+ *
+ *
+ * @author  Abhirath Koushik
+ * @date    10-16-2026
+ *
+ */
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+#include <sys/types.h>
+
+/*
+ * Sends everything from offset (or the current position of file_fd) up to EOF to the client
+ * using sendfile(), or splice() through a pipe if the file does not support sendfile. If the
+ * calling thread has a reply backlog (see pending_reply_set_target()), whatever the client
+ * socket cannot take right away is copied to it instead.
+ *
+ * Parameters:
+ *   client_fd: The client socket to reply on
+ *   file_fd: The file to send
+ *   offset: Position to start at, advanced past the sent data. If NULL the file position
+ *           of file_fd is used and updated instead
+ *
+ * Returns:
+ *   On Success: 0
+ *   On Failure: -1, with errno set to EINVAL if the file supports neither sendfile nor
+ *               splice and nothing was sent, so the caller can fall back to copying
+ */
+int zerocopy_send_file(int client_fd, int file_fd, off_t *offset);
+
+#endif /* ZEROCOPY_H */